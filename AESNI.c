@@ -1,10 +1,14 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <x86intrin.h>  // For __rdtsc()
 #include <wmmintrin.h>  // For AES-NI intrinsics
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_hist.h"
+#include "bench_perf.h"
 
 #define AES_BLOCK_SIZE 16
 #define AES_ROUNDS 10
@@ -72,6 +76,12 @@ void generate_random(uint8_t *buf, size_t len) {
 }
 
 int main() {
+    bench_isolate(0);
+    bench_timing_init();
+
+    bench_perf_t perf;
+    bench_perf_open(&perf);
+
     aes128_state_t state;
     size_t data_len = 1024 * 1024;  // 1 MB
     uint8_t *data = malloc(data_len);
@@ -81,20 +91,27 @@ int main() {
         perror("Failed to allocate memory");
         return 1;
     }
+    bench_prefault(data, data_len);
 
     const int runs = 10000;  // fewer runs for AES-NI (faster)
     uint64_t total_cycles = 0;
+    bench_hist_t hist;
+    bench_hist_init(&hist);
 
     for (int i = 0; i < runs; ++i) {
         generate_random(data, data_len);     // Random plaintext
         generate_random(key, sizeof(key));   // Random key
         aes128_key_expansion(key, &state);   // Key schedule
 
-        uint64_t start = __rdtsc();
+        bench_perf_start(&perf);
+        uint64_t start = bench_tsc_start();
         aes128_encrypt_buffer(&state, data, data_len);
-        uint64_t end = __rdtsc();
+        uint64_t end = bench_tsc_stop();
+        bench_perf_stop(&perf);
 
-        total_cycles += (end - start);
+        uint64_t cycles = bench_elapsed(start, end);
+        total_cycles += cycles;
+        bench_hist_record(&hist, cycles);
     }
 
     double avg_cycles = (double)total_cycles / runs;
@@ -107,6 +124,9 @@ int main() {
     printf("Total runs: %d\n", runs);
     printf("Average cycles (AES only): %.2f\n", avg_cycles);
     printf("Average cycles per byte: %.2f\n", avg_cycles / data_len);
+    printf("Average ns per byte: %.3f (TSC %.3f GHz)\n", bench_ns(avg_cycles) / data_len, bench_tsc_ghz);
+    bench_hist_print(&hist, "Cycles per byte", (double)data_len);
+    bench_perf_print(&perf, "Counters per byte", (double)data_len * runs);
 
     free(data);
     return 0;
@@ -1,17 +1,24 @@
 // mr_512_cycles_nogmp.c
 // Miller-Rabin test for 512-bit numbers without GMP
-// Works in Windows VS Code (MSVC or MinGW)
+// Randomness from the per-thread ChaCha20 generator in chacha_rng.h (Linux)
+// Modular arithmetic in Montgomery form (CIOS, R = 2^512)
+// miller_rabin_batch tests 8 candidates at a time in AVX-512 IFMA lanes
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
-#include <intrin.h>
+#include <x86intrin.h>
+#include "chacha_rng.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_hist.h"
 
 #define RUNS   10000
 #define LIMBS  8         // 512 bits / 64 bits
 #define ROUNDS 10        // Miller-Rabin rounds
+#define EXP_RUNS 2000    // exponentiations per method in the window comparison
 
 typedef struct {
     uint64_t v[LIMBS]; // little-endian (v[0] = least significant limb)
@@ -65,11 +72,7 @@ void big_rshift1(Big512 *x) {
 
 // Generate random 512-bit odd with MSB set
 void big_rand(Big512 *x) {
-    for (int i = 0; i < LIMBS; i++) {
-        uint64_t r = (((uint64_t)rand() << 32) ^ rand());
-        r = (r << 32) ^ rand();
-        x->v[i] = r;
-    }
+    rng_bytes(x->v, sizeof(x->v));
     x->v[LIMBS-1] |= (1ULL << 63); // force MSB
     x->v[0] |= 1ULL;               // make odd
 }
@@ -81,54 +84,253 @@ void big_print(const Big512 *x) {
     printf("\n");
 }
 
-// Modular multiplication (naive 512-bit * 512-bit % mod)
-void big_mulmod(Big512 *res, const Big512 *a, const Big512 *b, const Big512 *mod) {
-    __uint128_t tmp[2*LIMBS];
-    memset(tmp, 0, sizeof(tmp));
+// --- Montgomery arithmetic (R = 2^512) ---
+
+typedef struct {
+    Big512 n;        // odd modulus
+    uint64_t n0inv;  // -n^-1 mod 2^64
+    Big512 r2;       // R^2 mod n, for conversion into Montgomery form
+    Big512 one;      // R mod n, i.e. 1 in Montgomery form
+} MontCtx;
+
+// x = 2x mod n, for x < n
+static void big_dblmod(Big512 *x, const Big512 *n) {
+    uint64_t top = x->v[LIMBS-1] >> 63;
+    for (int i = LIMBS-1; i > 0; i--)
+        x->v[i] = (x->v[i] << 1) | (x->v[i-1] >> 63);
+    x->v[0] <<= 1;
+    if (top || big_cmp(x, n) >= 0) big_sub(x, x, n);
+}
+
+void mont_mul(const MontCtx *ctx, Big512 *res, const Big512 *a, const Big512 *b);
+
+// Per-modulus precomputation: n', R mod n and R^2 mod n
+void mont_init(MontCtx *ctx, const Big512 *n) {
+    big_copy(&ctx->n, n);
+
+    // Newton iteration: each step doubles the number of correct low bits
+    uint64_t inv = n->v[0];              // correct to 3 bits for odd n
+    for (int i = 0; i < 5; i++) inv *= 2 - n->v[0] * inv;
+    ctx->n0inv = (uint64_t)0 - inv;
+
+    // R mod n: R - n when the top bit of n is set, else by doubling from 1
+    Big512 x;
+    big_zero(&x);
+    if (n->v[LIMBS-1] >> 63) {
+        big_sub(&x, &x, n);
+    } else {
+        x.v[0] = 1;
+        for (int i = 0; i < LIMBS*64; i++) big_dblmod(&x, n);
+    }
+    big_copy(&ctx->one, &x);
+
+    // R^2 mod n: 2R mod n is 2 in Montgomery form, and nine Montgomery
+    // squarings take it to 2^512 = R, i.e. to R * R mod n
+    big_dblmod(&x, n);
+    for (int i = 0; i < 9; i++) mont_mul(ctx, &x, &x, &x);
+    big_copy(&ctx->r2, &x);
+}
+
+// res = a * b * R^-1 mod n (CIOS), for a, b < n; res may alias a or b
+void mont_mul(const MontCtx *ctx, Big512 *res, const Big512 *a, const Big512 *b) {
+    uint64_t t[LIMBS+2];
+    memset(t, 0, sizeof(t));
 
-    // multiply
     for (int i = 0; i < LIMBS; i++) {
-        __uint128_t carry = 0;
+        // t += a * b[i]
+        unsigned __int128 c = 0;
         for (int j = 0; j < LIMBS; j++) {
-            __uint128_t t = tmp[i+j] + (__uint128_t)a->v[i] * b->v[j] + carry;
-            tmp[i+j] = t & 0xFFFFFFFFFFFFFFFFULL;
-            carry = t >> 64;
+            c += (unsigned __int128)a->v[j] * b->v[i] + t[j];
+            t[j] = (uint64_t)c;
+            c >>= 64;
+        }
+        c += t[LIMBS];
+        t[LIMBS] = (uint64_t)c;
+        t[LIMBS+1] = (uint64_t)(c >> 64);
+
+        // t = (t + m * n) / 2^64, with m chosen so the low limb cancels
+        uint64_t m = t[0] * ctx->n0inv;
+        c = (unsigned __int128)m * ctx->n.v[0] + t[0];
+        c >>= 64;
+        for (int j = 1; j < LIMBS; j++) {
+            c += (unsigned __int128)m * ctx->n.v[j] + t[j];
+            t[j-1] = (uint64_t)c;
+            c >>= 64;
         }
-        tmp[i+LIMBS] += carry;
+        c += t[LIMBS];
+        t[LIMBS-1] = (uint64_t)c;
+        t[LIMBS] = t[LIMBS+1] + (uint64_t)(c >> 64);
     }
 
-    // Reduce modulo mod (simple subtraction method, not optimized)
+    // t < 2n: one conditional subtraction
     Big512 r;
-    for (int i = 0; i < LIMBS; i++) r.v[i] = (uint64_t)tmp[i];
-    while (big_cmp(&r, mod) >= 0) {
-        big_sub(&r, &r, mod);
-    }
+    memcpy(r.v, t, sizeof(r.v));
+    if (t[LIMBS] || big_cmp(&r, &ctx->n) >= 0) big_sub(&r, &r, &ctx->n);
     big_copy(res, &r);
 }
 
-// Modular exponentiation: res = base^exp mod mod
-void big_powmod(Big512 *res, const Big512 *base, const Big512 *exp, const Big512 *mod) {
-    Big512 result, b, e;
-    big_zero(&result); result.v[0] = 1;
+// a < n into Montgomery form: a * R mod n
+void mont_to(const MontCtx *ctx, Big512 *res, const Big512 *a) {
+    mont_mul(ctx, res, a, &ctx->r2);
+}
+
+// Out of Montgomery form: a * R^-1 mod n
+void mont_from(const MontCtx *ctx, Big512 *res, const Big512 *a) {
+    Big512 one;
+    big_zero(&one); one.v[0] = 1;
+    mont_mul(ctx, res, a, &one);
+}
+
+// Number of significant bits (0 for x = 0)
+int big_bitlen(const Big512 *x) {
+    for (int i = LIMBS-1; i >= 0; i--)
+        if (x->v[i]) return i*64 + 64 - __builtin_clzll(x->v[i]);
+    return 0;
+}
+
+static inline int big_bit(const Big512 *x, int i) {
+    return (int)((x->v[i/64] >> (i%64)) & 1);
+}
+
+// Bits i..i-len+1 of x as an integer (len <= 64, i-len+1 >= 0)
+static inline uint64_t big_bits(const Big512 *x, int i, int len) {
+    uint64_t r = 0;
+    for (int k = i; k > i - len; k--) r = (r << 1) | (uint64_t)big_bit(x, k);
+    return r;
+}
+
+#define WINDOW_MAX 6
+
+// Window width by exponent length: bigger tables only pay off for long
+// exponents (same break-even points as OpenSSL's BN_window_bits_for_exponent_size)
+int mont_window_bits(int bits) {
+    return bits > 671 ? 6 : bits > 239 ? 5 : bits > 79 ? 4 : bits > 23 ? 3 : 1;
+}
+
+// The powmod routines below take base and return res in Montgomery form
+// and return the number of Montgomery multiplications (squarings included)
+
+// Right-to-left binary square-and-multiply over all LIMBS*64 exponent bits
+int mont_powmod_binary(const MontCtx *ctx, Big512 *res, const Big512 *base, const Big512 *exp) {
+    Big512 result, b;
+    int mults = 0;
+    big_copy(&result, &ctx->one);
     big_copy(&b, base);
-    big_copy(&e, exp);
 
     for (int i = 0; i < LIMBS*64; i++) {
-        if (e.v[i/64] & (1ULL << (i%64))) {
-            big_mulmod(&result, &result, &b, mod);
+        if (exp->v[i/64] & (1ULL << (i%64))) {
+            mont_mul(ctx, &result, &result, &b);
+            mults++;
+        }
+        mont_mul(ctx, &b, &b, &b);
+        mults++;
+    }
+    big_copy(res, &result);
+    return mults;
+}
+
+// Left-to-right fixed window: table of base^0 .. base^(2^w - 1), then w
+// squarings and at most one multiplication per w-bit digit
+int mont_powmod_fixed(const MontCtx *ctx, Big512 *res, const Big512 *base, const Big512 *exp, int w) {
+    Big512 table[1 << WINDOW_MAX], result;
+    int bits = big_bitlen(exp), mults = 0;
+
+    big_copy(&table[0], &ctx->one);
+    big_copy(&table[1], base);
+    for (int k = 2; k < (1 << w); k++) {
+        mont_mul(ctx, &table[k], &table[k-1], base);
+        mults++;
+    }
+
+    int digits = (bits + w - 1) / w, started = 0;
+    big_copy(&result, &ctx->one);
+    for (int d = digits - 1; d >= 0; d--) {
+        int top = d*w + w - 1, len = w;
+        if (top >= bits) {                       // leading digit is short
+            len -= top - (bits - 1);
+            top = bits - 1;
+        }
+        uint64_t digit = big_bits(exp, top, len);
+        if (started) {
+            for (int k = 0; k < len; k++) mont_mul(ctx, &result, &result, &result);
+            mults += len;
+            if (digit) {
+                mont_mul(ctx, &result, &result, &table[digit]);
+                mults++;
+            }
+        } else if (digit) {
+            big_copy(&result, &table[digit]);
+            started = 1;
+        }
+    }
+    big_copy(res, &result);
+    return mults;
+}
+
+// Left-to-right sliding window: odd powers base^1, base^3 .. base^(2^w - 1);
+// runs of zero bits cost one squaring each, every window ends on a set bit
+int mont_powmod_sliding(const MontCtx *ctx, Big512 *res, const Big512 *base, const Big512 *exp, int w) {
+    Big512 table[1 << (WINDOW_MAX - 1)], b2, result;
+    int mults = 0, started = 0;
+
+    big_copy(&table[0], base);
+    if (w > 1) {
+        mont_mul(ctx, &b2, base, base);
+        mults++;
+        for (int k = 1; k < (1 << (w - 1)); k++) {
+            mont_mul(ctx, &table[k], &table[k-1], &b2);
+            mults++;
+        }
+    }
+
+    big_copy(&result, &ctx->one);
+    for (int i = big_bitlen(exp) - 1; i >= 0; ) {
+        if (!big_bit(exp, i)) {
+            if (started) {
+                mont_mul(ctx, &result, &result, &result);
+                mults++;
+            }
+            i--;
+            continue;
         }
-        big_mulmod(&b, &b, &b, mod);
+        int j = i - w + 1 < 0 ? 0 : i - w + 1;  // lowest bit of the window
+        while (!big_bit(exp, j)) j++;
+        uint64_t win = big_bits(exp, i, i - j + 1);
+        if (started) {
+            for (int k = 0; k < i - j + 1; k++) mont_mul(ctx, &result, &result, &result);
+            mont_mul(ctx, &result, &result, &table[win >> 1]);
+            mults += i - j + 2;
+        } else {
+            big_copy(&result, &table[win >> 1]);
+            started = 1;
+        }
+        i = j - 1;
     }
     big_copy(res, &result);
+    return mults;
+}
+
+// res = base^exp, base and res in Montgomery form
+void mont_powmod(const MontCtx *ctx, Big512 *res, const Big512 *base, const Big512 *exp) {
+    mont_powmod_sliding(ctx, res, base, exp, mont_window_bits(big_bitlen(exp)));
+}
+
+// Modular exponentiation: res = base^exp mod mod (odd mod, base < mod)
+void big_powmod(Big512 *res, const Big512 *base, const Big512 *exp, const Big512 *mod) {
+    MontCtx ctx;
+    Big512 b;
+    mont_init(&ctx, mod);
+    mont_to(&ctx, &b, base);
+    mont_powmod(&ctx, &b, &b, exp);
+    mont_from(&ctx, res, &b);
 }
 
-// Miller-Rabin primality test
+// Miller-Rabin primality test, entirely in the Montgomery domain of n
 int miller_rabin(const Big512 *n, int rounds) {
     if (n->v[0] % 2 == 0) return 0; // even
 
     // n-1 = d * 2^s
     Big512 n_minus1, d;
-    big_copy(&n_minus1, n);
     Big512 one; big_zero(&one); one.v[0] = 1;
     big_sub(&n_minus1, n, &one);
     big_copy(&d, &n_minus1);
@@ -139,6 +341,13 @@ int miller_rabin(const Big512 *n, int rounds) {
         s++;
     }
 
+    // 1 and n-1 = -1 in Montgomery form: R mod n and n - (R mod n)
+    MontCtx ctx;
+    Big512 one_m, minus1_m;
+    mont_init(&ctx, n);
+    big_copy(&one_m, &ctx.one);
+    big_sub(&minus1_m, n, &one_m);
+
     for (int i = 0; i < rounds; i++) {
         Big512 a;
         big_rand(&a);
@@ -146,45 +355,353 @@ int miller_rabin(const Big512 *n, int rounds) {
         if (big_cmp(&a, &n_minus1) >= 0) big_sub(&a, &a, &n_minus1);
 
         Big512 x;
-        big_powmod(&x, &a, &d, n);
-        if (big_cmp(&x, &one) == 0 || big_cmp(&x, &n_minus1) == 0) continue;
+        mont_to(&ctx, &x, &a);
+        mont_powmod(&ctx, &x, &x, &d);
+        if (big_cmp(&x, &one_m) == 0 || big_cmp(&x, &minus1_m) == 0) continue;
 
         int cont = 0;
         for (int r = 1; r < s; r++) {
-            big_mulmod(&x, &x, &x, n);
-            if (big_cmp(&x, &n_minus1) == 0) { cont = 1; break; }
+            mont_mul(&ctx, &x, &x, &x);
+            if (big_cmp(&x, &minus1_m) == 0) { cont = 1; break; }
         }
         if (!cont) return 0;
     }
     return 1;
 }
 
-int main() {
-    srand((unsigned)time(NULL));
+// --- Multi-buffer Miller-Rabin: 8 candidates per AVX-512 IFMA register ---
+//
+// Lane-sliced layout: vector j holds 52-bit limb j of all 8 candidates, so
+// one vpmadd52luq/vpmadd52huq advances the same limb product in every
+// lane, and a Montgomery multiplication is the schoolbook CIOS loop over
+// limb vectors with a per-lane quotient digit.  R' = 2^520, so 4n < R' and
+// values stay in [0, 2n) ("almost Montgomery") without final subtractions;
+// comparisons check both representatives.  The exponentiation uses a fixed
+// window, which gives every lane the same square-and-multiply schedule
+// even though the exponents differ; table entries are picked per lane
+// with masked moves.
 
-    uint64_t min_cycles = UINT64_MAX, max_cycles = 0;
-    long double sum_cycles = 0.0;
-    int probable_primes = 0;
+#define BATCH      8     // candidates per group (64-bit lanes of a zmm)
+#define L52        10    // 52-bit limbs per candidate
+#define MB_WINDOW  4     // fixed window bits (16-entry table per lane)
+#define MASK52     ((1ULL << 52) - 1)
 
-    for (int i = 0; i < RUNS; i++) {
-        Big512 n;
+#define MB_TARGET  __attribute__((target("avx512f,avx512ifma")))
+#define MB_UNROLL  _Pragma("GCC unroll 16")
+
+static int have_ifma(void) {
+    static int have = -1;
+    if (have < 0) {
+        __builtin_cpu_init();
+        have = __builtin_cpu_supports("avx512ifma");
+    }
+    return have;
+}
+
+// r[L52] = x in radix 2^52
+static void big_to52(uint64_t r[L52], const Big512 *x) {
+    for (int i = 0; i < L52; i++) {
+        int bit = 52*i, w = bit / 64, off = bit % 64;
+        uint64_t v = w < LIMBS ? x->v[w] >> off : 0;
+        if (off > 12 && w + 1 < LIMBS) v |= x->v[w+1] << (64 - off);
+        r[i] = v & MASK52;
+    }
+}
+
+// r = a + b in radix 2^52 (no overflow for values below 2^519)
+static void add52(uint64_t r[L52], const uint64_t a[L52], const uint64_t b[L52]) {
+    uint64_t c = 0;
+    for (int i = 0; i < L52; i++) {
+        c += a[i] + b[i];
+        r[i] = c & MASK52;
+        c >>= 52;
+    }
+}
+
+// v[j] = limb j of x[0..7]
+static MB_TARGET void mb_load(__m512i v[L52], uint64_t x[BATCH][L52]) {
+    for (int j = 0; j < L52; j++)
+        v[j] = _mm512_set_epi64(x[7][j], x[6][j], x[5][j], x[4][j], x[3][j], x[2][j], x[1][j], x[0][j]);
+}
+
+// Lanes where a == b (limbs are normalised, so equal values have equal limbs)
+static inline MB_TARGET __mmask8 mb_eq(const __m512i a[L52], const __m512i b[L52]) {
+    __mmask8 m = 0xff;
+    MB_UNROLL
+    for (int j = 0; j < L52; j++) m &= _mm512_cmpeq_epi64_mask(a[j], b[j]);
+    return m;
+}
+
+// r = a b R'^-1 mod n in every lane, for a, b < 2n; result < 2n with
+// normalised limbs.  r may alias a or b.
+static inline MB_TARGET void mb_mul(__m512i r[L52], const __m512i a[L52], const __m512i b[L52],
+                                    const __m512i n[L52], __m512i k0) {
+    const __m512i zero = _mm512_setzero_si512(), mask = _mm512_set1_epi64(MASK52);
+    __m512i t[L52 + 1];
+
+    MB_UNROLL
+    for (int j = 0; j <= L52; j++) t[j] = zero;
+    MB_UNROLL
+    for (int i = 0; i < L52; i++) {
+        // t += a * b[i]
+        MB_UNROLL
+        for (int j = 0; j < L52; j++) {
+            t[j] = _mm512_madd52lo_epu64(t[j], a[j], b[i]);
+            t[j+1] = _mm512_madd52hi_epu64(t[j+1], a[j], b[i]);
+        }
+        // t = (t + q n) / 2^52, q = t[0] k0 mod 2^52 per lane
+        __m512i q = _mm512_madd52lo_epu64(zero, t[0], k0);
+        MB_UNROLL
+        for (int j = 0; j < L52; j++) {
+            t[j] = _mm512_madd52lo_epu64(t[j], n[j], q);
+            t[j+1] = _mm512_madd52hi_epu64(t[j+1], n[j], q);
+        }
+        __m512i c = _mm512_srli_epi64(t[0], 52);
+        MB_UNROLL
+        for (int j = 0; j < L52; j++) t[j] = t[j+1];
+        t[0] = _mm512_add_epi64(t[0], c);
+        t[L52] = zero;
+    }
+    MB_UNROLL
+    for (int j = 0; j < L52 - 1; j++) {
+        t[j+1] = _mm512_add_epi64(t[j+1], _mm512_srli_epi64(t[j], 52));
+        r[j] = _mm512_and_si512(t[j], mask);
+    }
+    r[L52-1] = t[L52-1];
+}
+
+// r = table[idx] per lane
+static inline MB_TARGET void mb_select(__m512i r[L52], __m512i table[][L52], __m512i idx) {
+    for (int j = 0; j < L52; j++) r[j] = table[0][j];
+    for (int k = 1; k < (1 << MB_WINDOW); k++) {
+        __mmask8 m = _mm512_cmpeq_epi64_mask(idx, _mm512_set1_epi64(k));
+        MB_UNROLL
+        for (int j = 0; j < L52; j++) r[j] = _mm512_mask_mov_epi64(r[j], m, table[k][j]);
+    }
+}
+
+// x = x^d[lane] per lane, in and out of Montgomery form; one = R' mod n
+static MB_TARGET void mb_powmod(__m512i x[L52], const Big512 d[BATCH], const __m512i n[L52],
+                                __m512i k0, const __m512i one[L52]) {
+    __m512i table[1 << MB_WINDOW][L52];
+    int bits = 0;
+
+    for (int l = 0; l < BATCH; l++) {
+        int b = big_bitlen(&d[l]);
+        if (b > bits) bits = b;
+    }
+    memcpy(table[0], one, sizeof(table[0]));
+    memcpy(table[1], x, sizeof(table[1]));
+    for (int k = 2; k < (1 << MB_WINDOW); k++) mb_mul(table[k], table[k-1], x, n, k0);
+
+    // Windows from the top; bits past a lane's exponent length read as 0
+    int nwin = (bits + MB_WINDOW - 1) / MB_WINDOW;
+    for (int win = nwin - 1; win >= 0; win--) {
+        uint64_t idx[BATCH];
+        for (int l = 0; l < BATCH; l++) {
+            idx[l] = 0;
+            for (int k = MB_WINDOW - 1; k >= 0; k--) {
+                int bit = win * MB_WINDOW + k;
+                idx[l] = (idx[l] << 1) | (uint64_t)(bit < LIMBS*64 && big_bit(&d[l], bit));
+            }
+        }
+        __m512i sel[L52];
+        mb_select(sel, table, _mm512_loadu_si512(idx));
+        if (win == nwin - 1) {
+            memcpy(x, sel, sizeof(sel));
+            continue;
+        }
+        for (int k = 0; k < MB_WINDOW; k++) mb_mul(x, x, x, n, k0);
+        mb_mul(x, x, sel, n, k0);
+    }
+    if (nwin == 0) memcpy(x, one, sizeof(table[0]));
+}
+
+// One group of 8 odd candidates; returns the lanes that pass all rounds
+static MB_TARGET __mmask8 mb_miller_rabin8(const Big512 cand[BATCH], __mmask8 active, int rounds) {
+    uint64_t n52[BATCH][L52], rr52[BATCH][L52], one52[BATCH][L52], m152[BATCH][L52];
+    uint64_t one2[BATCH][L52], m12[BATCH][L52], k0[BATCH];
+    Big512 d[BATCH], n_minus1[BATCH];
+    int s[BATCH], smax = 0;
+
+    // Per lane: d and s with n - 1 = d 2^s, k0 = -n^-1 mod 2^52, and in
+    // radix 2^52 R'^2 = 2^1040 and R' = 2^520 mod n (from mont_init's R
+    // and R^2 by doubling), -1 = n - R', and both + n
+    for (int l = 0; l < BATCH; l++) {
+        MontCtx ctx;
+        Big512 one, x;
+        big_zero(&one); one.v[0] = 1;
+        big_sub(&n_minus1[l], &cand[l], &one);
+        big_copy(&d[l], &n_minus1[l]);
+        for (s[l] = 0; big_even(&d[l]) && s[l] < LIMBS*64; s[l]++) big_rshift1(&d[l]);
+        if ((active >> l & 1) && s[l] > smax) smax = s[l];
+
+        mont_init(&ctx, &cand[l]);
+        k0[l] = ctx.n0inv & MASK52;
+        big_to52(n52[l], &cand[l]);
+        big_copy(&x, &ctx.r2);
+        for (int i = 0; i < 16; i++) big_dblmod(&x, &cand[l]);
+        big_to52(rr52[l], &x);
+        big_copy(&x, &ctx.one);
+        for (int i = 0; i < 8; i++) big_dblmod(&x, &cand[l]);
+        big_to52(one52[l], &x);
+        big_sub(&x, &cand[l], &x);
+        big_to52(m152[l], &x);
+        add52(one2[l], one52[l], n52[l]);
+        add52(m12[l], m152[l], n52[l]);
+    }
+
+    __m512i n[L52], rr[L52], one[L52], m1[L52], onep[L52], m1p[L52];
+    __m512i kv = _mm512_loadu_si512(k0);
+    mb_load(n, n52);
+    mb_load(rr, rr52);
+    mb_load(one, one52);
+    mb_load(m1, m152);
+    mb_load(onep, one2);
+    mb_load(m1p, m12);
+
+    for (int i = 0; i < rounds && active; i++) {
+        uint64_t a52[BATCH][L52];
+        __m512i x[L52];
+        for (int l = 0; l < BATCH; l++) {
+            Big512 a;
+            big_rand(&a);
+            if (big_cmp(&a, &n_minus1[l]) >= 0) big_sub(&a, &a, &n_minus1[l]);
+            big_to52(a52[l], &a);
+        }
+        mb_load(x, a52);
+        mb_mul(x, x, rr, n, kv);                   // into Montgomery form
+        mb_powmod(x, d, n, kv, one);
+
+        __mmask8 pass = mb_eq(x, one) | mb_eq(x, onep) | mb_eq(x, m1) | mb_eq(x, m1p);
+        for (int r = 1; r < smax && (active & ~pass); r++) {
+            __mmask8 live = 0;
+            for (int l = 0; l < BATCH; l++) live |= (__mmask8)((r < s[l]) << l);
+            mb_mul(x, x, x, n, kv);
+            pass |= live & (mb_eq(x, m1) | mb_eq(x, m1p));
+        }
+        active &= pass;
+    }
+    return active;
+}
+
+// Miller-Rabin with ROUNDS random bases on each of count candidates,
+// results[i] = 1 for probable primes.  Groups of 8 run in the IFMA lanes;
+// without AVX-512 IFMA this is a loop over miller_rabin().
+void miller_rabin_batch(const Big512 candidates[], int count, int results[]) {
+    if (!have_ifma()) {
+        for (int i = 0; i < count; i++) results[i] = miller_rabin(&candidates[i], ROUNDS);
+        return;
+    }
+    for (int base = 0; base < count; base += BATCH) {
+        Big512 group[BATCH];
+        __mmask8 active = 0;
+        // Even numbers and the padding of a short last group run on a
+        // stand-in odd modulus with their lane switched off
+        for (int l = 0; l < BATCH; l++) {
+            int i = base + l < count ? base + l : base;
+            big_copy(&group[l], &candidates[i]);
+            if (base + l < count && !big_even(&group[l])) active |= (__mmask8)(1 << l);
+            group[l].v[0] |= 1;
+        }
+        __mmask8 prime = mb_miller_rabin8(group, active, ROUNDS);
+        for (int l = 0; l < BATCH && base + l < count; l++) results[base + l] = prime >> l & 1;
+    }
+}
+
+// Binary vs fixed vs sliding window on full-length exponents mod random
+// 512-bit odd moduli: multiplications per exponentiation and cycles
+static void bench_exponentiation(void) {
+    static const char *names[3] = { "binary (all 512 bits)", "fixed window", "sliding window" };
+    bench_hist_t hist[3];
+    long mults[3] = { 0, 0, 0 };
+    int mismatches = 0;
+
+    for (int k = 0; k < 3; k++) bench_hist_init(&hist[k]);
+    for (int i = 0; i < EXP_RUNS; i++) {
+        Big512 n, e, a, r[3];
+        MontCtx ctx;
         big_rand(&n);
+        big_rand(&e);
+        big_rand(&a);
+        if (big_cmp(&a, &n) >= 0) big_sub(&a, &a, &n);
+        mont_init(&ctx, &n);
+        mont_to(&ctx, &a, &a);
+        int w = mont_window_bits(big_bitlen(&e));
 
-        uint64_t t0 = __rdtsc();
-        int is_prime = miller_rabin(&n, ROUNDS);
-        uint64_t t1 = __rdtsc();
+        for (int k = 0; k < 3; k++) {
+            uint64_t t0 = bench_tsc_start();
+            int m = k == 0 ? mont_powmod_binary(&ctx, &r[k], &a, &e)
+                  : k == 1 ? mont_powmod_fixed(&ctx, &r[k], &a, &e, w)
+                           : mont_powmod_sliding(&ctx, &r[k], &a, &e, w);
+            uint64_t t1 = bench_tsc_stop();
+            bench_hist_record(&hist[k], bench_elapsed(t0, t1));
+            mults[k] += m;
+        }
+        mismatches += big_cmp(&r[0], &r[1]) != 0 || big_cmp(&r[0], &r[2]) != 0;
+    }
+
+    printf("\n512-bit modular exponentiation, %d runs, window %d (%s):\n", EXP_RUNS,
+           mont_window_bits(LIMBS*64), mismatches ? "RESULTS DIFFER" : "results agree");
+    for (int k = 0; k < 3; k++) {
+        printf("  %-22s %6.1f mulmods/exp, avg cycles %.0f, speedup %.2fx\n", names[k],
+               (double)mults[k] / EXP_RUNS, bench_hist_mean(&hist[k]),
+               bench_hist_mean(&hist[0]) / bench_hist_mean(&hist[k]));
+        bench_hist_print(&hist[k], "    cycles", 1.0);
+    }
+}
+
+int main() {
+    bench_isolate(0);
+    bench_timing_init();
+
+    static Big512 candidates[RUNS];
+    static int sequential_results[RUNS], batch_results[RUNS];
+    bench_hist_t hist;
+    bench_hist_init(&hist);
+    int probable_primes = 0, batch_primes = 0, disagree = 0;
+    uint64_t sequential_cycles = 0;
+
+    for (int i = 0; i < RUNS; i++) big_rand(&candidates[i]);
 
-        uint64_t cycles = t1 - t0;
-        if (cycles < min_cycles) min_cycles = cycles;
-        if (cycles > max_cycles) max_cycles = cycles;
-        sum_cycles += cycles;
+    for (int i = 0; i < RUNS; i++) {
+        uint64_t t0 = bench_tsc_start();
+        int is_prime = miller_rabin(&candidates[i], ROUNDS);
+        uint64_t t1 = bench_tsc_stop();
+
+        uint64_t cycles = bench_elapsed(t0, t1);
+        bench_hist_record(&hist, cycles);
+        sequential_cycles += cycles;
         probable_primes += is_prime;
+        sequential_results[i] = is_prime;
+    }
+
+    // Same candidates through the multi-buffer path
+    uint64_t t0 = bench_tsc_start();
+    miller_rabin_batch(candidates, RUNS, batch_results);
+    uint64_t batch_cycles = bench_elapsed(t0, bench_tsc_stop());
+    for (int i = 0; i < RUNS; i++) {
+        batch_primes += batch_results[i];
+        disagree += batch_results[i] != sequential_results[i];
     }
 
     printf("Miller–Rabin on %d random 512-bit numbers:\n", RUNS);
-    printf("  Min cycles: %llu\n", (unsigned long long)min_cycles);
-    printf("  Max cycles: %llu\n", (unsigned long long)max_cycles);
-    printf("  Avg cycles: %.0Lf\n", sum_cycles / RUNS);
+    printf("  Min cycles: %llu\n", (unsigned long long)hist.min);
+    printf("  Max cycles: %llu\n", (unsigned long long)hist.max);
+    printf("  Avg cycles: %.0f (%.1f us)\n", bench_hist_mean(&hist), bench_ns(bench_hist_mean(&hist)) / 1e3);
+    bench_hist_print(&hist, "  Cycles", 1.0);
     printf("  Probable primes: %d\n", probable_primes);
+
+    double seq_rate = RUNS / (bench_ns((double)sequential_cycles) / 1e9);
+    double batch_rate = RUNS / (bench_ns((double)batch_cycles) / 1e9);
+    printf("\nmiller_rabin_batch (%s), same candidates:\n",
+           have_ifma() ? "8 lanes, AVX-512 IFMA" : "no IFMA, sequential fallback");
+    printf("  Sequential: %.0f candidates/s\n", seq_rate);
+    printf("  Batch:      %.0f candidates/s (%.0f cycles per candidate), speedup %.2fx\n",
+           batch_rate, (double)batch_cycles / RUNS, batch_rate / seq_rate);
+    printf("  Probable primes: %d, verdicts differing from the sequential run: %d\n",
+           batch_primes, disagree);
+
+    bench_exponentiation();
     return 0;
 }
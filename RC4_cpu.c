@@ -1,86 +1,235 @@
+// RC4_cpu.c
+// RC4 with explicit lengths on the shared uint8_t core (rc4.h), so keys and
+// data may contain any byte, including NUL.  Cycles are counted around the
+// key schedule and the PRGA only, not around I/O or argument handling.
+//
+//   RC4_cpu <key> <plaintext>                  original argv mode, hex output
+//   RC4_cpu -k key | -K hexkey [-x] [in|- [out|-]]
+//                                              stream a file or stdin in
+//                                              CHUNK-byte pieces; raw output
+//                                              unless -x; cycles to stderr
+//
+// Compile: gcc -O2 RC4_cpu.c -o RC4_cpu
+
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
-#include <x86intrin.h>  // For __rdtsc()
+#include <getopt.h>
+#include "rc4.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_perf.h"
 
-#define N 256   // 2^8
+#define CHUNK (64 * 1024)   // bytes per read/encrypt/write step
 
-void swap(unsigned char *a, unsigned char *b) 
+int KSA(const uint8_t *key, size_t keylen, rc4_state_t *st)
 {
-    int tmp = *a;
-    *a = *b;
-    *b = tmp;
+    if (keylen == 0 || keylen > 256)
+        return -1;
+    rc4_init(st, key, keylen);
+    return 0;
 }
 
-int KSA(char *key, unsigned char *S) 
+// out = in ^ keystream; out may equal in
+int PRGA(rc4_state_t *st, const uint8_t *in, uint8_t *out, size_t len)
 {
-    int len = strlen(key);
-    int j = 0;
+    if (out != in)
+        memcpy(out, in, len);
+    rc4_crypt(st, out, len);
+    return 0;
+}
 
-    for(int i = 0; i < N; i++)
-        S[i] = i;
+int RC4(const uint8_t *key, size_t keylen, const uint8_t *in, uint8_t *out, size_t len)
+{
+    rc4_state_t st;
+    if (KSA(key, keylen, &st) != 0)
+        return -1;
+    return PRGA(&st, in, out, len);
+}
 
-    for(int i = 0; i < N; i++) 
+static int parse_hex(const char *hex, uint8_t *out, size_t *len)
+{
+    size_t n = strlen(hex);
+    if (n == 0 || n % 2 != 0 || n / 2 > 256)
+        return -1;
+    for (size_t i = 0; i < n / 2; i++)
     {
-        j = (j + S[i] + key[i % len]) % N;
-        swap(&S[i], &S[j]);
+        unsigned v;
+        if (sscanf(hex + 2 * i, "%2x", &v) != 1)
+            return -1;
+        out[i] = (uint8_t)v;
     }
-
+    *len = n / 2;
     return 0;
 }
 
-int PRGA(unsigned char *S, char *plaintext, unsigned char *ciphertext) 
+// Encrypt in to out chunk by chunk; returns 0 on success
+static int rc4_stream(rc4_state_t *st, FILE *in, FILE *out, int hex, const bench_perf_t *perf,
+                      unsigned long long *cycles, unsigned long long *bytes)
 {
-    int i = 0;
-    int j = 0;
+    static const char digits[] = "0123456789abcdef";
+    static uint8_t buf[CHUNK];
+    static char text[2 * CHUNK];
+    size_t n;
 
-    for(size_t n = 0, len = strlen(plaintext); n < len; n++) 
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
     {
-        i = (i + 1) % N;
-        j = (j + S[i]) % N;
+        bench_perf_start(perf);
+        unsigned long long start = bench_tsc_start();
+        rc4_crypt(st, buf, n);
+        *cycles += bench_elapsed(start, bench_tsc_stop());
+        bench_perf_stop(perf);
+        *bytes += n;
+
+        if (hex)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                text[2 * i] = digits[buf[i] >> 4];
+                text[2 * i + 1] = digits[buf[i] & 0x0f];
+            }
+            if (fwrite(text, 1, 2 * n, out) != 2 * n)
+                return -1;
+        }
+        else if (fwrite(buf, 1, n, out) != n)
+            return -1;
+    }
+    if (hex)
+        fputc('\n', out);
+    return ferror(in) || ferror(out) ? -1 : 0;
+}
 
-        swap(&S[i], &S[j]);
-        int rnd = S[(S[i] + S[j]) % N];
+static int stream_main(int argc, char *argv[])
+{
+    uint8_t key[256];
+    size_t keylen = 0;
+    int hex = 0, opt;
+
+    while ((opt = getopt(argc, argv, "k:K:xh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'k':
+            keylen = strlen(optarg);
+            if (keylen == 0 || keylen > 256)
+            {
+                fprintf(stderr, "Key must be 1..256 bytes\n");
+                return 2;
+            }
+            memcpy(key, optarg, keylen);
+            break;
+        case 'K':
+            if (parse_hex(optarg, key, &keylen) != 0)
+            {
+                fprintf(stderr, "Hex key must be 2..512 hex digits\n");
+                return 2;
+            }
+            break;
+        case 'x':
+            hex = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s -k key | -K hexkey [-x] [in|- [out|-]]\n", argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (keylen == 0 || argc - optind > 2)
+    {
+        fprintf(stderr, "Usage: %s -k key | -K hexkey [-x] [in|- [out|-]]\n", argv[0]);
+        return 2;
+    }
 
-        ciphertext[n] = rnd ^ plaintext[n];
+    FILE *in = stdin, *out = stdout;
+    if (optind < argc && strcmp(argv[optind], "-") != 0 && !(in = fopen(argv[optind], "rb")))
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (optind + 1 < argc && strcmp(argv[optind + 1], "-") != 0 && !(out = fopen(argv[optind + 1], "wb")))
+    {
+        perror(argv[optind + 1]);
+        return 1;
     }
 
-    return 0;
+    rc4_state_t st;
+    unsigned long long start = bench_tsc_start();
+    KSA(key, keylen, &st);
+    unsigned long long ksa_cycles = bench_elapsed(start, bench_tsc_stop());
+
+    bench_perf_t perf;
+    bench_perf_open(&perf);
+    unsigned long long prga_cycles = 0, bytes = 0;
+    int rc = rc4_stream(&st, in, out, hex, &perf, &prga_cycles, &bytes);
+    if (rc != 0)
+        perror("RC4");
+    if (out != stdout && fclose(out) != 0)
+        rc = -1;
+    else if (out == stdout)
+        fflush(stdout);
+    if (in != stdin)
+        fclose(in);
+
+    fprintf(stderr, "Bytes: %llu\n", bytes);
+    fprintf(stderr, "KSA clock cycles: %llu\n", ksa_cycles);
+    fprintf(stderr, "PRGA clock cycles: %llu", prga_cycles);
+    if (bytes > 0)
+        fprintf(stderr, " (%.2f cycles/byte, %.3f ns/byte)", (double)prga_cycles / bytes,
+                bench_ns((double)prga_cycles) / bytes);
+    fprintf(stderr, "\n");
+    if (bytes > 0)
+        bench_perf_fprint(stderr, &perf, "PRGA counters per byte", (double)bytes);
+    bench_perf_close(&perf);
+    return rc == 0 ? 0 : 1;
 }
 
-int RC4(char *key, char *plaintext, unsigned char *ciphertext) 
+int main(int argc, char *argv[])
 {
-    unsigned char S[N];
-    KSA(key, S);
-    PRGA(S, plaintext, ciphertext);
-    return 0;
-}
+    bench_isolate(0);
+    bench_timing_init();
 
-int main(int argc, char *argv[]) 
-{
-    if(argc < 3) 
+    if (argc > 1 && argv[1][0] == '-')
+        return stream_main(argc, argv);
+
+    if(argc < 3)
     {
         printf("Usage: %s <key> <plaintext>\n", argv[0]);
+        printf("       %s -k key | -K hexkey [-x] [in|- [out|-]]\n", argv[0]);
         return -1;
     }
 
+    size_t keylen = strlen(argv[1]);
     size_t len = strlen(argv[2]);
-    unsigned char *ciphertext = malloc(len);
+    uint8_t *ciphertext = malloc(len ? len : 1);
+    if (!ciphertext)
+    {
+        perror("Failed to allocate memory");
+        return 1;
+    }
 
     // Read TSC before RC4
-    unsigned long long start = __rdtsc();
+    unsigned long long start = bench_tsc_start();
 
-    RC4(argv[1], argv[2], ciphertext);
+    int rc = RC4((const uint8_t *)argv[1], keylen, (const uint8_t *)argv[2], ciphertext, len);
 
     // Read TSC after RC4
-    unsigned long long end = __rdtsc();
+    unsigned long long end = bench_tsc_stop();
+
+    if (rc != 0)
+    {
+        printf("Key must be 1..256 bytes\n");
+        free(ciphertext);
+        return -1;
+    }
 
     printf("Ciphertext (hex): ");
     for(size_t i = 0; i < len; i++)
         printf("%02X ", ciphertext[i]);
     printf("\n");
 
-    printf("CPU Clock Cycles: %llu\n", end - start);
+    printf("CPU Clock Cycles: %llu (%.0f ns)\n", (unsigned long long)bench_elapsed(start, end),
+           bench_ns((double)bench_elapsed(start, end)));
 
     free(ciphertext);
     return 0;
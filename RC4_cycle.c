@@ -1,67 +1,14 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <x86intrin.h>  // For __rdtsc()
-
-// Macro for one PRGA step
-#define RC4_STEP(i, j, S, data, idx) do { \
-    i += 1; \
-    j += S[i]; \
-    tmp = S[i]; S[i] = S[j]; S[j] = tmp; \
-    data[idx++] ^= S[(uint8_t)(S[i] + S[j])]; \
-} while (0)
-
-typedef struct {
-    uint8_t S[256];
-    uint8_t i;
-    uint8_t j;
-} rc4_state_t;
-
-void rc4_init(rc4_state_t *state, const uint8_t *key, size_t keylen) {
-    uint8_t j = 0, tmp;
-    for (uint16_t i = 0; i < 256; ++i) {
-        state->S[i] = (uint8_t)i;
-    }
-    for (uint16_t i = 0; i < 256; ++i) {
-        j += state->S[i] + key[i % keylen];
-        tmp = state->S[i];
-        state->S[i] = state->S[j];
-        state->S[j] = tmp;
-    }
-    state->i = 0;
-    state->j = 0;
-}
-
-void rc4_crypt(rc4_state_t *state, uint8_t *data, size_t len) {
-    uint8_t i = state->i;
-    uint8_t j = state->j;
-    uint8_t tmp;
-    size_t idx = 0;
-
-    // Unrolled loop (16x) for speed
-    size_t blocks = len / 16;
-    for (size_t b = 0; b < blocks; ++b) {
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-    }
-
-    // Remaining bytes
-    size_t remain = len % 16;
-    for (size_t r = 0; r < remain; ++r) {
-        RC4_STEP(i, j, state->S, data, idx);
-    }
-
-    state->i = i;
-    state->j = j;
-}
+#include "rc4.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_hist.h"
+#include "bench_perf.h"
 
 // Simple LCG for generating pseudo-random values
 static uint32_t lcg_seed = 123456789;
@@ -76,7 +23,73 @@ void generate_random(uint8_t *buf, size_t len) {
     }
 }
 
+// Multi-stream benchmark: RC4_MAX_STREAMS sessions of MULTI_LEN bytes, as a
+// gateway decrypting many independent connections would see them
+#define MULTI_LEN  (64 * 1024)
+#define MULTI_RUNS 2000
+
+// Aggregate bytes per cycle for all sessions; width 1 = rc4_crypt per session
+static double bench_multi(uint8_t *const sess[], int width) {
+    rc4_state_t st[RC4_MAX_STREAMS], *stp[RC4_MAX_STREAMS];
+    size_t lens[RC4_MAX_STREAMS];
+    uint8_t key[16];
+    uint64_t total_cycles = 0;
+
+    for (int k = 0; k < RC4_MAX_STREAMS; ++k) {
+        stp[k] = &st[k];
+        lens[k] = MULTI_LEN;
+    }
+    for (int r = 0; r < MULTI_RUNS; ++r) {
+        for (int k = 0; k < RC4_MAX_STREAMS; ++k) {
+            generate_random(key, sizeof(key));
+            rc4_init(&st[k], key, sizeof(key));
+        }
+        uint64_t start = bench_tsc_start();
+        if (width == 1) {
+            for (int k = 0; k < RC4_MAX_STREAMS; ++k) rc4_crypt(&st[k], sess[k], MULTI_LEN);
+        } else {
+            rc4_crypt_multi(stp, sess, lens, RC4_MAX_STREAMS, width);
+        }
+        total_cycles += bench_elapsed(start, bench_tsc_stop());
+    }
+    return (double)MULTI_LEN * RC4_MAX_STREAMS * MULTI_RUNS / (double)total_cycles;
+}
+
+// rc4_crypt_multi must equal rc4_crypt per session, with unequal lengths
+static int multi_self_check(uint8_t *const sess[]) {
+    static const size_t lens[RC4_MAX_STREAMS] = { 1, 4096, 17, 1000, 5000, 3, 513, 0 };
+    static uint8_t ref[RC4_MAX_STREAMS][5000];
+    rc4_state_t a[RC4_MAX_STREAMS], b[RC4_MAX_STREAMS], *ap[RC4_MAX_STREAMS];
+    uint8_t key[16];
+
+    for (int width = 2; width <= RC4_MAX_STREAMS; width *= 2) {
+        for (size_t n = 1; n <= RC4_MAX_STREAMS; ++n) {
+            for (size_t k = 0; k < n; ++k) {
+                generate_random(key, sizeof(key));
+                rc4_init(&a[k], key, sizeof(key));
+                b[k] = a[k];
+                ap[k] = &a[k];
+                generate_random(sess[k], lens[k]);
+                memcpy(ref[k], sess[k], lens[k]);
+            }
+            rc4_crypt_multi(ap, sess, lens, n, width);
+            for (size_t k = 0; k < n; ++k) {
+                rc4_crypt(&b[k], ref[k], lens[k]);
+                if (memcmp(ref[k], sess[k], lens[k]) != 0 || a[k].i != b[k].i || a[k].j != b[k].j)
+                    return 0;
+            }
+        }
+    }
+    return 1;
+}
+
 int main() {
+    bench_isolate(0);
+    bench_timing_init();
+
+    bench_perf_t perf;
+    bench_perf_open(&perf);
+
     rc4_state_t state;
     size_t data_len = 1024 * 1024;  // 1 MB
     uint8_t *data = malloc(data_len);
@@ -86,20 +99,27 @@ int main() {
         perror("Failed to allocate memory");
         return 1;
     }
+    bench_prefault(data, data_len);
 
     const int runs = 10000;  // Fewer runs for quicker test on Windows
     uint64_t total_cycles = 0;
+    bench_hist_t hist;
+    bench_hist_init(&hist);
 
     for (int i = 0; i < runs; ++i) {
         generate_random(data, data_len);     // Random plaintext
         generate_random(key, sizeof(key));   // Random key
         rc4_init(&state, key, sizeof(key));  // KSA
 
-        uint64_t start = __rdtsc();
+        bench_perf_start(&perf);
+        uint64_t start = bench_tsc_start();
         rc4_crypt(&state, data, data_len);   // PRGA
-        uint64_t end = __rdtsc();
+        uint64_t end = bench_tsc_stop();
+        bench_perf_stop(&perf);
 
-        total_cycles += (end - start);
+        uint64_t cycles = bench_elapsed(start, end);
+        total_cycles += cycles;
+        bench_hist_record(&hist, cycles);
     }
 
     double avg_cycles = (double)total_cycles / runs;
@@ -114,7 +134,45 @@ int main() {
     printf("Total runs: %d\n", runs);
     printf("Average cycles (PRGA only): %.2f\n", avg_cycles);
     printf("Average cycles per byte: %.2f\n", avg_cycles / data_len);
+    printf("Average ns per byte: %.3f (TSC %.3f GHz)\n", bench_ns(avg_cycles) / data_len, bench_tsc_ghz);
+    bench_hist_print(&hist, "Cycles per byte", (double)data_len);
+    bench_perf_print(&perf, "Counters per byte", (double)data_len * runs);
+
+
+    // Independent sessions, interleaved.  Each session is offset so the
+    // buffers do not share 4 KB page offsets (4K aliasing would stall the
+    // interleaved loads behind unrelated stores).
+    uint8_t *arena = malloc(RC4_MAX_STREAMS * (MULTI_LEN + 320));
+    uint8_t *sess[RC4_MAX_STREAMS];
+    if (!arena) {
+        perror("Failed to allocate memory");
+        free(data);
+        return 1;
+    }
+    for (int k = 0; k < RC4_MAX_STREAMS; ++k) {
+        sess[k] = arena + (size_t)k * (MULTI_LEN + 320);
+    }
+    if (!multi_self_check(sess)) {
+        printf("\nMulti-stream self-check FAILED\n");
+        free(arena);
+        free(data);
+        return 1;
+    }
+    for (int k = 0; k < RC4_MAX_STREAMS; ++k) {
+        generate_random(sess[k], MULTI_LEN);
+    }
+
+    printf("\nMulti-stream (%d sessions x %d bytes, %d runs):\n",
+           RC4_MAX_STREAMS, MULTI_LEN, MULTI_RUNS);
+    double single = bench_multi(sess, 1);
+    printf("  1 stream  : %.3f bytes/cycle\n", single);
+    for (int width = 2; width <= RC4_MAX_STREAMS; width *= 2) {
+        double agg = bench_multi(sess, width);
+        printf("  %d streams : %.3f bytes/cycle aggregate (%.2fx single)\n",
+               width, agg, agg / single);
+    }
 
+    free(arena);
     free(data);
     return 0;
 }
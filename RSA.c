@@ -1,56 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
 #include <stdint.h>
-
-// Miller-Rabin Primality Test (modular exponentiation part)
-uint64_t modexp(uint64_t base, uint64_t exp, uint64_t mod) {
-    uint64_t result = 1;
-    base %= mod;
-    while (exp > 0) {
-        if (exp & 1)
-            result = (result * base) % mod;
-        exp >>= 1;
-        base = (base * base) % mod;
-    }
-    return result;
-}
-
-// Miller-Rabin test
-int is_prime(uint64_t n, int k) {
-    if (n < 2) return 0;
-    if (n == 2 || n == 3) return 1;
-    if (n % 2 == 0) return 0;
-
-    // Write n - 1 as 2^r * d
-    uint64_t d = n - 1;
-    int r = 0;
-    while ((d & 1) == 0) {
-        d >>= 1;
-        r++;
-    }
-
-    for (int i = 0; i < k; i++) {
-        uint64_t a = 2 + rand() % (n - 4);
-        uint64_t x = modexp(a, d, n);
-
-        if (x == 1 || x == n - 1)
-            continue;
-
-        int is_composite = 1;
-        for (int j = 0; j < r - 1; j++) {
-            x = modexp(x, 2, n);
-            if (x == n - 1) {
-                is_composite = 0;
-                break;
-            }
-        }
-
-        if (is_composite)
-            return 0; // Composite
-    }
-    return 1; // Probably prime
-}
+#include "chacha_rng.h"
+#include "mont64.h"
 
 // GCD
 uint64_t gcd(uint64_t a, uint64_t b) {
@@ -91,14 +43,12 @@ int64_t modinv(int64_t a, int64_t m) {
 uint64_t generate_prime(int min, int max) {
     uint64_t p;
     do {
-        p = min + rand() % (max - min);
-    } while (!is_prime(p, 5));
+        p = min + rng_uniform(max - min);
+    } while (!is_prime64(p));
     return p;
 }
 
 int main() {
-    srand(time(NULL));
-
     // Step 1: Generate two primes
     uint64_t p = generate_prime(100, 300);
     uint64_t q = generate_prime(100, 300);
@@ -113,7 +63,7 @@ int main() {
     // Step 3: Choose e such that gcd(e, phi) = 1
     uint64_t e;
     do {
-        e = 3 + rand() % (phi - 3); // small odd number
+        e = 3 + rng_uniform(phi - 3); // small odd number
     } while (gcd(e, phi) != 1);
     printf("Chosen e = %llu (public exponent)\n", e);
 
@@ -126,10 +76,10 @@ int main() {
     printf("\nEnter a number as plaintext (less than %llu): ", n);
     scanf("%llu", &plaintext);
 
-    uint64_t ciphertext = modexp(plaintext, e, n);
+    uint64_t ciphertext = modexp64(plaintext, e, n);
     printf("Encrypted ciphertext = %llu\n", ciphertext);
 
-    uint64_t decrypted = modexp(ciphertext, d, n);
+    uint64_t decrypted = modexp64(ciphertext, d, n);
     printf("Decrypted plaintext = %llu\n", decrypted);
 
     return 0;
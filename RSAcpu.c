@@ -1,33 +1,43 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <time.h>
-#include <x86intrin.h>  // For __rdtsc()
+#include "chacha_rng.h"
+#include "mont64.h"
+#include "bench_env.h"
+#include "bench_timing.h"
 
 #define MAX_LEN 1024
-#define MILLER_RABIN_ITERATIONS 8
+#define BENCH_TESTS 1000000   // primality tests per set in bench mode
+#define BASELINE_ROUNDS 8     // witnesses of the random-witness test in bench mode
 
 // Global accumulator for Miller-Rabin cycles
 uint64_t miller_rabin_total_cycles = 0;
 
-// Modular exponentiation
-uint64_t modexp(uint64_t base, uint64_t exp, uint64_t mod) 
+// The previous primality test, kept for the bench-mode comparison: k
+// random witnesses and square-and-multiply with a 128-bit % per step (the
+// original 64-bit (a * b) % n overflowed above 2^32)
+static uint64_t mulmod_div(uint64_t a, uint64_t b, uint64_t mod)
+{
+    return (uint64_t)((unsigned __int128)a * b % mod);
+}
+
+static uint64_t modexp_div(uint64_t base, uint64_t exp, uint64_t mod)
 {
     uint64_t result = 1;
     base %= mod;
-    while (exp) 
+    while (exp)
     {
         if (exp & 1)
-            result = (result * base) % mod;
+            result = mulmod_div(result, base, mod);
         exp >>= 1;
-        base = (base * base) % mod;
+        base = mulmod_div(base, base, mod);
     }
     return result;
 }
 
-// Miller-Rabin Primality Test
-int is_prime(uint64_t n, int k) 
+static int is_prime_random_witness(uint64_t n, int k)
 {
     if (n < 2) return 0;
     if (n == 2 || n == 3) return 1;
@@ -35,23 +45,23 @@ int is_prime(uint64_t n, int k)
 
     uint64_t d = n - 1;
     int r = 0;
-    while ((d & 1) == 0) 
+    while ((d & 1) == 0)
     {
         d >>= 1;
         r++;
     }
 
-    for (int i = 0; i < k; i++) 
+    for (int i = 0; i < k; i++)
     {
-        uint64_t a = 2 + rand() % (n - 4);
-        uint64_t x = modexp(a, d, n);
+        uint64_t a = 2 + rng_uniform(n - 4);
+        uint64_t x = modexp_div(a, d, n);
         if (x == 1 || x == n - 1) continue;
 
         int is_composite = 1;
-        for (int j = 0; j < r - 1; j++) 
+        for (int j = 0; j < r - 1; j++)
         {
-            x = modexp(x, 2, n);
-            if (x == n - 1) 
+            x = mulmod_div(x, x, n);
+            if (x == n - 1)
             {
                 is_composite = 0;
                 break;
@@ -63,34 +73,13 @@ int is_prime(uint64_t n, int k)
     return 1;
 }
 
-// GCD
-uint64_t gcd(uint64_t a, uint64_t b) 
-{
-    while (b) 
-    {
-        uint64_t t = b;
-        b = a % b;
-        a = t;
-    }
-    return a;
-}
-
-// Modular inverse (Extended Euclidean Algorithm)
-int64_t modinv(int64_t a, int64_t m) 
+// Reads one decimal number of up to 128 bits; 0 at end of input, on "-1"
+// or on anything else that is not a number
+static int scan_u128(u128 *x)
 {
-    int64_t m0 = m, t, q;
-    int64_t x0 = 0, x1 = 1;
-    if (m == 1) return 0;
-    while (a > 1) 
-    {
-        q = a / m;
-        t = m;
-        m = a % m; a = t;
-        t = x0;
-        x0 = x1 - q * x0;
-        x1 = t;
-    }
-    return (x1 < 0) ? x1 + m0 : x1;
+    char tok[48];
+    if (scanf("%47s", tok) != 1) return 0;
+    return u128_parse(tok, x);
 }
 
 // Generate a large prime in a range
@@ -99,14 +88,14 @@ uint64_t generate_large_prime(uint64_t min, uint64_t max)
     uint64_t p;
     do 
     {
-        p = min + (uint64_t)rand() * rand() % (max - min);
+        p = min + rng_uniform(max - min);
 
         // Time Miller-Rabin test
-        uint64_t start_mr = __rdtsc();
-        int result = is_prime(p, MILLER_RABIN_ITERATIONS);
-        uint64_t end_mr = __rdtsc();
+        uint64_t start_mr = bench_tsc_start();
+        int result = is_prime64(p);
+        uint64_t end_mr = bench_tsc_stop();
 
-        miller_rabin_total_cycles += (end_mr - start_mr);
+        miller_rabin_total_cycles += bench_elapsed(start_mr, end_mr);
 
         if (result) break;
 
@@ -114,37 +103,84 @@ uint64_t generate_large_prime(uint64_t min, uint64_t max)
     return p;
 }
 
+// Primality tests per second on random odd numbers, in the key-generation
+// range and over all 64-bit sizes: is_prime64() against the old test
+static void bench_primality(void)
+{
+    static uint64_t numbers[BENCH_TESTS];
+    static const char *const sets[2] = { "odd n in [1e9, 1e11)", "odd n < 2^64, all sizes" };
+
+    printf("Primality tests, %d numbers per set (%d-witness test for comparison)\n",
+           BENCH_TESTS, BASELINE_ROUNDS);
+    for (int set = 0; set < 2; set++)
+    {
+        for (int i = 0; i < BENCH_TESTS; i++)
+        {
+            uint64_t n = set == 0 ? 1000000000ULL + rng_uniform(99000000000ULL)
+                                  : rng_u64() >> (i % 64);
+            numbers[i] = n | 1;
+        }
+
+        int primes_det = 0, primes_rnd = 0, disagree = 0;
+        uint64_t start = bench_tsc_start();
+        for (int i = 0; i < BENCH_TESTS; i++)
+            primes_det += is_prime64(numbers[i]);
+        uint64_t cyc_det = bench_elapsed(start, bench_tsc_stop());
+
+        start = bench_tsc_start();
+        for (int i = 0; i < BENCH_TESTS; i++)
+            primes_rnd += is_prime_random_witness(numbers[i], BASELINE_ROUNDS);
+        uint64_t cyc_rnd = bench_elapsed(start, bench_tsc_stop());
+
+        for (int i = 0; i < BENCH_TESTS; i++)
+            disagree += is_prime64(numbers[i]) != is_prime_random_witness(numbers[i], BASELINE_ROUNDS);
+
+        double det_rate = BENCH_TESTS / (bench_ns((double)cyc_det) / 1e9);
+        double rnd_rate = BENCH_TESTS / (bench_ns((double)cyc_rnd) / 1e9);
+        printf("\n%s:\n", sets[set]);
+        printf("  deterministic, Montgomery: %12.0f tests/s (%6.1f cycles/test), %d primes\n",
+               det_rate, (double)cyc_det / BENCH_TESTS, primes_det);
+        printf("  %d random witnesses, %%:    %12.0f tests/s (%6.1f cycles/test), %d primes\n",
+               BASELINE_ROUNDS, rnd_rate, (double)cyc_rnd / BENCH_TESTS, primes_rnd);
+        printf("  speedup %.2fx, verdicts differing: %d\n", det_rate / rnd_rate, disagree);
+    }
+}
+
 int main() 
 {
-    srand(time(NULL));
+    bench_isolate(0);
+    bench_timing_init();
 
     char mode[16];
-    printf("Enter mode (encrypt/decrypt): ");
+    printf("Enter mode (encrypt/decrypt/bench): ");
     scanf("%s", mode);
     getchar(); // consume leftover newline
 
     if (strcmp(mode, "encrypt") == 0) 
     {
         // Time Key Generation
-        uint64_t start_gen = __rdtsc();
+        uint64_t start_gen = bench_tsc_start();
         
         uint64_t p = generate_large_prime(1000000000ULL, 100000000000ULL);
         uint64_t q = generate_large_prime(1000000000ULL, 100000000000ULL);
-        uint64_t n = p * q;
-        uint64_t phi = (p - 1) * (q - 1);
+        u128 n = (u128)p * q;                 // up to 2^73: two-word modulus
+        u128 phi = (u128)(p - 1) * (q - 1);
 
-        uint64_t e = 65537;
-        while (gcd(e, phi) != 1) e++;
+        u128 e = 65537;
+        while (gcd128(e, phi) != 1) e++;
 
-        uint64_t d = modinv(e, phi);
+        u128 d = modinv128(e, phi);
 
-        uint64_t end_gen = __rdtsc();
+        uint64_t end_gen = bench_tsc_stop();
 
         printf("\nGenerated RSA Parameters:\n");
-        printf("p = %llu\nq = %llu\nn = %llu\nphi(n) = %llu\ne = %llu\nd = %llu\n",
-               p, q, n, phi, e, d);
-        printf("Clock cycles for key generation: %llu\n", end_gen - start_gen);
-        printf("Clock cycles for Miller-Rabin tests: %llu\n", miller_rabin_total_cycles);
+        char buf[4][40];
+        printf("p = %llu\nq = %llu\nn = %s\nphi(n) = %s\ne = %s\nd = %s\n",
+               (unsigned long long)p, (unsigned long long)q, u128_format(buf[0], n),
+               u128_format(buf[1], phi), u128_format(buf[2], e), u128_format(buf[3], d));
+        printf("Clock cycles for key generation: %llu (%.0f ns)\n", (unsigned long long)bench_elapsed(start_gen, end_gen),
+               bench_ns((double)bench_elapsed(start_gen, end_gen)));
+        printf("Clock cycles for Miller-Rabin tests: %llu\n", (unsigned long long)miller_rabin_total_cycles);
 
         // Input plaintext
         char plaintext[MAX_LEN];
@@ -153,42 +189,51 @@ int main()
         plaintext[strcspn(plaintext, "\n")] = '\0';
 
         size_t len = strlen(plaintext);
-        uint64_t ciphertext[MAX_LEN];
+        u128 ciphertext[MAX_LEN];
+        mont128_t ctx;
 
         // Time Encryption
-        uint64_t start_enc = __rdtsc();
+        uint64_t start_enc = bench_tsc_start();
+        mont128_init(&ctx, n);
         for (size_t i = 0; i < len; i++) 
         {
-            ciphertext[i] = modexp((uint64_t)plaintext[i], e, n);
+            ciphertext[i] = mont128_modexp(&ctx, (unsigned char)plaintext[i], e);
         }
-        uint64_t end_enc = __rdtsc();
+        uint64_t end_enc = bench_tsc_stop();
 
         printf("\nCiphertext:\n");
         for (size_t i = 0; i < len; i++) 
         {
-            printf("%llu ", ciphertext[i]);
+            printf("%s ", u128_format(buf[0], ciphertext[i]));
         }
-        printf("\nClock cycles for encryption: %llu\n", end_enc - start_enc);
-        printf("Average cycles per byte: %.2f\n", (double)(end_enc - start_enc) / len);
+        printf("\nClock cycles for encryption: %llu (%.0f ns)\n", (unsigned long long)bench_elapsed(start_enc, end_enc),
+               bench_ns((double)bench_elapsed(start_enc, end_enc)));
+        printf("Average cycles per byte: %.2f\n", (double)bench_elapsed(start_enc, end_enc) / len);
 
     } 
     else if (strcmp(mode, "decrypt") == 0) 
     {
-        uint64_t n, d;
+        u128 n = 0, d = 0;
         printf("Enter modulus n: ");
-        scanf("%llu", &n);
+        scan_u128(&n);
         printf("Enter private exponent d: ");
-        scanf("%llu", &d);
+        scan_u128(&d);
         getchar(); // consume newline
+        if (n < 3 || !(n & 1))
+        {
+            printf("Invalid modulus.\n");
+            return 1;
+        }
 
         printf("Enter ciphertext (space-separated, end with -1):\n");
 
-        uint64_t ciphertext[MAX_LEN];
+        u128 ciphertext[MAX_LEN];
+        mont128_t ctx;
         size_t len = 0;
-        while (1) 
+        while (len < MAX_LEN - 1) 
         {
-            uint64_t val;
-            if (scanf("%llu", &val) != 1 || val == (uint64_t)-1)
+            u128 val;
+            if (!scan_u128(&val))
                 break;
             ciphertext[len++] = val;
         }
@@ -196,21 +241,27 @@ int main()
         char decrypted[MAX_LEN];
 
         // Time Decryption
-        uint64_t start_dec = __rdtsc();
+        uint64_t start_dec = bench_tsc_start();
+        mont128_init(&ctx, n);
         for (size_t i = 0; i < len; i++) 
         {
-            decrypted[i] = (char)modexp(ciphertext[i], d, n);
+            decrypted[i] = (char)mont128_modexp(&ctx, ciphertext[i], d);
         }
-        uint64_t end_dec = __rdtsc();
+        uint64_t end_dec = bench_tsc_stop();
         decrypted[len] = '\0';
 
         printf("\nDecrypted text:\n%s\n", decrypted);
-        printf("Clock cycles for decryption: %llu\n", end_dec - start_dec);
-        printf("Average cycles per byte: %.2f\n", (double)(end_dec - start_dec) / len);
+        printf("Clock cycles for decryption: %llu (%.0f ns)\n", (unsigned long long)bench_elapsed(start_dec, end_dec),
+               bench_ns((double)bench_elapsed(start_dec, end_dec)));
+        printf("Average cycles per byte: %.2f\n", (double)bench_elapsed(start_dec, end_dec) / len);
     } 
+    else if (strcmp(mode, "bench") == 0) 
+    {
+        bench_primality();
+    }
     else 
     {
-        printf("Invalid mode. Use 'encrypt' or 'decrypt'.\n");
+        printf("Invalid mode. Use 'encrypt', 'decrypt' or 'bench'.\n");
     }
 
     return 0;
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <time.h>
 #include <gmp.h>
@@ -11,50 +12,21 @@
 #include <sys/mman.h>
 #include <sched.h>
 #include <errno.h>
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_hist.h"
 
 
 #define PRIME_BITS 512            /* set to 1024 as requested */
 #define ITER_PRIME_GEN 1000000        /* default 1000; set to 1000000 for assignment - WARNING: slow */
 #define PROB_PRIME_REPS 25         /* Miller-Rabin reps for mpz_probab_prime_p */
 #define MSG_BITS (PRIME_BITS*2)    /* message bits: choose 2*prime for security; set to 1024 if you want exact */
+#define DEC_RUNS 200               /* repetitions for the full vs CRT decryption comparison */
 const char *PRNG_NAME = "Mersenne Twister (gmp_randinit_mt)";
 
 /* public exponent e = 2^16 + 1 */
 const unsigned long E_EXP = (1UL<<16) + 1UL;
 
-static inline uint64_t rdtsc_start(void) {
-    unsigned int a, d;
-    asm volatile("cpuid\n\t"  /* serialize */
-                 "rdtsc\n\t"
-                 "mov %%eax, %0\n\t"
-                 "mov %%edx, %1\n\t"
-                 : "=r"(a), "=r"(d)
-                 :
-                 : "%rax", "%rbx", "%rcx", "%rdx");
-    return ((uint64_t)d << 32) | a;
-}
-static inline uint64_t rdtsc_end(void) {
-    unsigned int a, d;
-    asm volatile("rdtscp\n\t"   /* rdtscp is ordered */
-                 "mov %%eax, %0\n\t"
-                 "mov %%edx, %1\n\t"
-                 "cpuid\n\t"      /* serialize */
-                 : "=r"(a), "=r"(d)
-                 :
-                 : "%rax", "%rbx", "%rcx", "%rdx");
-    return ((uint64_t)d << 32) | a;
-}
-
-/* pin to CPU 0 for consistent measurements */
-void pin_to_cpu0(void) {
-    cpu_set_t cpus;
-    CPU_ZERO(&cpus);
-    CPU_SET(0, &cpus);
-    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
-        perror("sched_setaffinity");
-    }
-}
-
 /* seed gmp RNG from /dev/urandom */
 void seed_gmp_rng(gmp_randstate_t state) {
     int fd = open("/dev/urandom", O_RDONLY);
@@ -99,10 +71,10 @@ void print_mpz_info(const char *label, mpz_t v) {
 
 /* safe multiplication with timing */
 uint64_t timed_mul(mpz_t out, mpz_t a, mpz_t b) {
-    uint64_t s = rdtsc_start();
+    uint64_t s = bench_tsc_start();
     mpz_mul(out, a, b);
-    uint64_t e = rdtsc_end();
-    return e - s;
+    uint64_t e = bench_tsc_stop();
+    return bench_elapsed(s, e);
 }
 
 /* safe subtraction / phi compute timing */
@@ -111,34 +83,81 @@ uint64_t timed_phi(mpz_t phi, mpz_t p, mpz_t q) {
     mpz_t t1, t2;
     mpz_init(t1);
     mpz_init(t2);
-    uint64_t s = rdtsc_start();
+    uint64_t s = bench_tsc_start();
     mpz_sub_ui(t1, p, 1);
     mpz_sub_ui(t2, q, 1);
     mpz_mul(phi, t1, t2);
-    uint64_t e = rdtsc_end();
+    uint64_t e = bench_tsc_stop();
     mpz_clear(t1);
     mpz_clear(t2);
-    return e - s;
+    return bench_elapsed(s, e);
 }
 
 /* modular inverse timing */
 uint64_t timed_modinv(mpz_t d, mpz_t e, mpz_t phi) {
-    uint64_t s = rdtsc_start();
+    uint64_t s = bench_tsc_start();
     if (mpz_invert(d, e, phi) == 0) {
         /* no inverse - shouldn't happen for chosen e if phi odd and gcd=1 */
-        uint64_t e_t = rdtsc_end();
-        return e_t - s;
+        uint64_t e_t = bench_tsc_stop();
+        return bench_elapsed(s, e_t);
     }
-    uint64_t e_t = rdtsc_end();
-    return e_t - s;
+    uint64_t e_t = bench_tsc_stop();
+    return bench_elapsed(s, e_t);
+}
+
+/* CRT private key (PKCS #1 form): dP = d mod (p-1), dQ = d mod (q-1),
+   qInv = q^-1 mod p */
+typedef struct {
+    mpz_t p, q, dP, dQ, qInv;
+} rsa_priv_t;
+
+void rsa_priv_init(rsa_priv_t *k, mpz_t p, mpz_t q, mpz_t d) {
+    mpz_inits(k->p, k->q, k->dP, k->dQ, k->qInv, NULL);
+    mpz_set(k->p, p);
+    mpz_set(k->q, q);
+    mpz_sub_ui(k->dP, p, 1);
+    mpz_mod(k->dP, d, k->dP);
+    mpz_sub_ui(k->dQ, q, 1);
+    mpz_mod(k->dQ, d, k->dQ);
+    mpz_invert(k->qInv, q, p);
+}
+
+void rsa_priv_clear(rsa_priv_t *k) {
+    mpz_clears(k->p, k->q, k->dP, k->dQ, k->qInv, NULL);
+}
+
+/* m = c^d mod N with two half-size exponentiations and Garner's
+   recombination: m1 = c^dP mod p, m2 = c^dQ mod q,
+   h = qInv * (m1 - m2) mod p, m = m2 + h * q */
+void rsa_decrypt_crt(mpz_t m, mpz_t c, const rsa_priv_t *k) {
+    mpz_t m1, m2, h;
+    mpz_inits(m1, m2, h, NULL);
+    mpz_mod(m1, c, k->p);
+    mpz_powm(m1, m1, k->dP, k->p);
+    mpz_mod(m2, c, k->q);
+    mpz_powm(m2, m2, k->dQ, k->q);
+    mpz_sub(h, m1, m2);
+    mpz_mul(h, h, k->qInv);
+    mpz_mod(h, h, k->p);        /* mpz_mod result is never negative */
+    mpz_mul(m, h, k->q);
+    mpz_add(m, m, m2);
+    mpz_clears(m1, m2, h, NULL);
+}
+
+/* CRT decryption timing */
+uint64_t timed_decrypt_crt(mpz_t out, mpz_t c, const rsa_priv_t *k) {
+    uint64_t s = bench_tsc_start();
+    rsa_decrypt_crt(out, c, k);
+    uint64_t e = bench_tsc_stop();
+    return bench_elapsed(s, e);
 }
 
 /* modular exponentiation timing */
 uint64_t timed_powmod(mpz_t out, mpz_t base, mpz_t exp, mpz_t mod) {
-    uint64_t s = rdtsc_start();
+    uint64_t s = bench_tsc_start();
     mpz_powm(out, base, exp, mod);
-    uint64_t e = rdtsc_end();
-    return e - s;
+    uint64_t e = bench_tsc_stop();
+    return bench_elapsed(s, e);
 }
 
 int main(int argc, char **argv) {
@@ -150,15 +169,11 @@ int main(int argc, char **argv) {
 
     printf("Assignment steps 1-4 implementation (following RSA_Assignment.pdf). PRNG: %s\n", PRNG_NAME);
     printf("Prime bits: %u; ITER_PRIME_GEN: %lu\n", bits, iter);
-    printf("Ensure CPU governor=performance and pin to single core for best reproducibility.\n\n");
-
-    /* pin to CPU0 */
-    pin_to_cpu0();
+    printf("\n");
 
-    /* lock memory to avoid paging interference */
-    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
-        perror("mlockall (warning)");
-    }
+    /* pin to an isolated core, SCHED_FIFO, mlockall; warns about governor/turbo */
+    bench_isolate(0);
+    bench_timing_init();
 
     /* init GMP RNG */
     gmp_randstate_t st;
@@ -175,26 +190,32 @@ int main(int argc, char **argv) {
     __uint128_t sum_cycles_p = 0; /* may be large: use 128-bit accumulator */
     uint64_t min_cycles_q = (uint64_t)-1, max_cycles_q = 0;
     __uint128_t sum_cycles_q = 0;
+    /* full distributions: a few candidates take far longer than the mean */
+    static bench_hist_t hist_p, hist_q;
+    bench_hist_init(&hist_p);
+    bench_hist_init(&hist_q);
 
     /* a single iter will do a pair p and q generation and record cycles for each */
     for (unsigned long i = 0; i < iter; ++i) {
         /* generate p */
-        uint64_t s1 = rdtsc_start();
+        uint64_t s1 = bench_tsc_start();
         generate_prime_with_checks(p, st, bits);
-        uint64_t e1 = rdtsc_end();
-        uint64_t cyc_p = e1 - s1;
+        uint64_t e1 = bench_tsc_stop();
+        uint64_t cyc_p = bench_elapsed(s1, e1);
         if (cyc_p < min_cycles_p) min_cycles_p = cyc_p;
         if (cyc_p > max_cycles_p) max_cycles_p = cyc_p;
         sum_cycles_p += cyc_p;
+        bench_hist_record(&hist_p, cyc_p);
 
         /* generate q */
-        uint64_t s2 = rdtsc_start();
+        uint64_t s2 = bench_tsc_start();
         generate_prime_with_checks(q, st, bits);
-        uint64_t e2 = rdtsc_end();
-        uint64_t cyc_q = e2 - s2;
+        uint64_t e2 = bench_tsc_stop();
+        uint64_t cyc_q = bench_elapsed(s2, e2);
         if (cyc_q < min_cycles_q) min_cycles_q = cyc_q;
         if (cyc_q > max_cycles_q) max_cycles_q = cyc_q;
         sum_cycles_q += cyc_q;
+        bench_hist_record(&hist_q, cyc_q);
 
         /* optional progress for long runs */
         if ((i+1) % (iter/10 == 0 ? 1 : (iter/10)) == 0) {
@@ -210,6 +231,8 @@ int main(int argc, char **argv) {
     printf("PRNG: %s\n", PRNG_NAME);
     printf("p generation cycles: min=%" PRIu64 ", max=%" PRIu64 ", avg=%.2f\n", min_cycles_p, max_cycles_p, avg_p);
     printf("q generation cycles: min=%" PRIu64 ", max=%" PRIu64 ", avg=%.2f\n", min_cycles_q, max_cycles_q, avg_q);
+    bench_hist_print(&hist_p, "p generation cycles", 1.0);
+    bench_hist_print(&hist_q, "q generation cycles", 1.0);
     printf("Detailed calculation (p): sum=%lu, avg = sum/iter -> %.2f\n", (unsigned long)sum_cycles_p, avg_p);
     printf("Detailed calculation (q): sum=%lu, avg = sum/iter -> %.2f\n", (unsigned long)sum_cycles_q, avg_q);
 
@@ -223,7 +246,7 @@ int main(int argc, char **argv) {
     printf("\nStep 2: N and phi calculation cycles:\n");
     printf("N = p * q cycles = %" PRIu64 "\n", cyc_N);
     printf("phi = (p-1)*(q-1) cycles = %" PRIu64 "\n", cyc_phi);
-    printf("Detail: (timed_mul used rdtsc before/after mpz_mul), (timed_phi subtracts then multiplies)\n");
+    printf("Detail: (timed_mul brackets mpz_mul with bench_tsc_start/stop), (timed_phi subtracts then multiplies)\n");
 
     /* Step 3: compute d = e^-1 mod phi */
     uint64_t cyc_d = timed_modinv(d, e_mpz, phi);
@@ -259,6 +282,39 @@ int main(int argc, char **argv) {
         printf("Verification: m' != m : FAILURE\n");
     }
 
+    /* Step 4b: CRT decryption with (p, q, dP, dQ, qInv) against the full powm */
+    rsa_priv_t key;
+    uint64_t s_key = bench_tsc_start();
+    rsa_priv_init(&key, p, q, d);
+    uint64_t cyc_key = bench_elapsed(s_key, bench_tsc_stop());
+    uint64_t cyc_crt = timed_decrypt_crt(mprime, c, &key);
+
+    printf("\nStep 4b: CRT decryption (two %u-bit exponentiations + Garner):\n", bits);
+    printf("CRT key precomputation (dP, dQ, qInv): %" PRIu64 " cycles\n", cyc_key);
+    printf("decryption (CRT): %" PRIu64 " cycles\n", cyc_crt);
+    if (mpz_cmp(m, mprime) == 0) {
+        printf("Verification: CRT m' == m : OK\n");
+    } else {
+        printf("Verification: CRT m' != m : FAILURE\n");
+    }
+
+    /* single runs are noisy; compare the two decryptions over DEC_RUNS runs */
+    static bench_hist_t hist_full, hist_crt;
+    bench_hist_init(&hist_full);
+    bench_hist_init(&hist_crt);
+    int crt_ok = 1;
+    for (int r = 0; r < DEC_RUNS; ++r) {
+        bench_hist_record(&hist_full, timed_powmod(mprime, c, d, N));
+        bench_hist_record(&hist_crt, timed_decrypt_crt(mprime, c, &key));
+        crt_ok &= (mpz_cmp(m, mprime) == 0);
+    }
+    printf("Comparison over %d decryptions (%s):\n", DEC_RUNS, crt_ok ? "all verified" : "CRT MISMATCH");
+    bench_hist_print(&hist_full, "  full mpz_powm cycles", 1.0);
+    bench_hist_print(&hist_crt, "  CRT cycles          ", 1.0);
+    printf("  CRT speedup (median): %.2fx\n",
+           (double)bench_hist_value_at(&hist_full, 50.0) / (double)bench_hist_value_at(&hist_crt, 50.0));
+    rsa_priv_clear(&key);
+
     /* Print final computed values briefly */
     print_mpz_info("p", p);
     print_mpz_info("q", q);
@@ -0,0 +1,160 @@
+// bench_env.h
+// Linux benchmark isolation shared by the cycle-counting programs
+// (header-only)
+//
+// bench_isolate() prepares the process before measuring:
+// - pins to one core: $BENCH_CPU if set, else the first core listed in
+//   /sys/devices/system/cpu/isolated (isolcpus=), else the last core we
+//   are allowed to run on (core 0 takes most interrupts)
+// - switches to SCHED_FIFO when permitted and another core is left for the
+//   rest of the system ($BENCH_FIFO=0 disables it, =1 forces an attempt)
+// - mlockall(MCL_CURRENT | MCL_FUTURE) so measured code never page-faults;
+//   MCL_CURRENT only when RLIMIT_MEMLOCK is finite and we are not root,
+//   otherwise later mallocs would fail once the limit is reached
+// - warns when the cpufreq governor is not "performance" or turbo is on,
+//   since both make cycles per byte depend on temperature and load
+// One summary line goes to stderr.  BENCH_ALL_CPUS skips pinning and
+// SCHED_FIFO for multi-threaded benchmarks.  Buffers allocated after the
+// call are locked too but must still be touched once: bench_prefault().
+
+#ifndef BENCH_ENV_H
+#define BENCH_ENV_H
+
+// Needs _GNU_SOURCE defined before the first system header (sched_setaffinity)
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#define BENCH_ALL_CPUS 0x1   // multi-threaded: no pinning, no SCHED_FIFO
+
+typedef struct {
+    int cpu;          // pinned core, -1 if not pinned
+    int isolated;     // core is in the isolcpus= list
+    int fifo;         // running SCHED_FIFO
+    int locked;       // mlockall succeeded
+} bench_env_t;
+
+// First line of a small sysfs file, newline stripped; 0 on success
+static inline int bench_read_sysfs(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    if (!fgets(buf, (int)len, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+// First core of an isolcpus-style list ("2-3,6"); -1 if empty
+static inline int bench_first_isolated(void) {
+    char buf[256];
+    if (bench_read_sysfs("/sys/devices/system/cpu/isolated", buf, sizeof(buf)) != 0 || buf[0] == '\0')
+        return -1;
+    return atoi(buf);
+}
+
+static inline int bench_pick_cpu(int *isolated) {
+    const char *env = getenv("BENCH_CPU");
+    int iso = bench_first_isolated();
+    cpu_set_t set;
+
+    *isolated = 0;
+    if (env && *env) {
+        int cpu = atoi(env);
+        *isolated = (cpu == iso);
+        return cpu;
+    }
+    if (iso >= 0) {
+        *isolated = 1;
+        return iso;
+    }
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return 0;
+    for (int cpu = CPU_SETSIZE - 1; cpu >= 0; --cpu)
+        if (CPU_ISSET(cpu, &set)) return cpu;
+    return 0;
+}
+
+// Governor and turbo warnings for the core we run on
+static inline void bench_check_cpufreq(int cpu) {
+    char path[128], buf[64];
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu < 0 ? 0 : cpu);
+    if (bench_read_sysfs(path, buf, sizeof(buf)) == 0 && strcmp(buf, "performance") != 0)
+        fprintf(stderr, "bench: warning: cpufreq governor is \"%s\", not \"performance\"\n", buf);
+    if (bench_read_sysfs("/sys/devices/system/cpu/intel_pstate/no_turbo", buf, sizeof(buf)) == 0 &&
+        strcmp(buf, "0") == 0)
+        fprintf(stderr, "bench: warning: turbo is on (intel_pstate/no_turbo = 0)\n");
+    if (bench_read_sysfs("/sys/devices/system/cpu/cpufreq/boost", buf, sizeof(buf)) == 0 &&
+        strcmp(buf, "1") == 0)
+        fprintf(stderr, "bench: warning: turbo is on (cpufreq/boost = 1)\n");
+}
+
+// Touch every page so the first measured run does not take the faults, and
+// lock it when mlockall could not cover future allocations (best effort)
+static inline void bench_prefault(void *buf, size_t len) {
+    volatile uint8_t *p = (volatile uint8_t *)buf;
+    mlock(buf, len);
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) page = 4096;
+    for (size_t i = 0; i < len; i += (size_t)page) p[i] = p[i];
+    if (len > 0) p[len - 1] = p[len - 1];
+}
+
+static inline bench_env_t bench_isolate(int flags) {
+    bench_env_t env = { -1, 0, 0, 0 };
+    const char *fifo_env = getenv("BENCH_FIFO");
+    const char *fifo_note = "off";
+
+    if (!(flags & BENCH_ALL_CPUS)) {
+        int cpu = bench_pick_cpu(&env.isolated);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == 0)
+            env.cpu = cpu;
+        else
+            perror("bench: sched_setaffinity");
+
+        if (fifo_env && strcmp(fifo_env, "0") == 0) {
+            fifo_note = "off (BENCH_FIFO=0)";
+        } else if (!(fifo_env && strcmp(fifo_env, "1") == 0) && sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+            fifo_note = "off (single cpu)";
+        } else {
+            struct sched_param sp;
+            memset(&sp, 0, sizeof(sp));
+            sp.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+            if (sched_setscheduler(0, SCHED_FIFO, &sp) == 0) {
+                env.fifo = 1;
+                fifo_note = "on";
+            } else {
+                fifo_note = (errno == EPERM) ? "off (not permitted)" : "off";
+            }
+        }
+    }
+
+    struct rlimit rl;
+    int future = (geteuid() == 0) ||
+                 (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur == RLIM_INFINITY);
+    env.locked = (mlockall(MCL_CURRENT | (future ? MCL_FUTURE : 0)) == 0);
+    bench_check_cpufreq(env.cpu);
+
+    if (env.cpu >= 0)
+        fprintf(stderr, "bench: cpu %d%s, SCHED_FIFO %s, mlockall %s\n", env.cpu,
+                env.isolated ? " (isolated)" : "", fifo_note,
+                !env.locked ? "failed" : future ? "ok" : "ok (current pages only)");
+    else
+        fprintf(stderr, "bench: all cpus, mlockall %s\n",
+                !env.locked ? "failed" : future ? "ok" : "ok (current pages only)");
+    return env;
+}
+
+#endif // BENCH_ENV_H
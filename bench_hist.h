@@ -0,0 +1,136 @@
+// bench_hist.h
+// Log-bucketed cycle histogram for per-run latency distributions
+// (HdrHistogram-style, header-only)
+//
+// Values below BENCH_HIST_SUB are counted exactly; above that every power
+// of two is split into BENCH_HIST_SUB linear sub-buckets, so any recorded
+// value is known to within 1/BENCH_HIST_SUB (under 1%) over the whole
+// 64-bit range.  Recording is a clz, a shift and an increment, cheap enough
+// to sit between two timed runs.
+//
+// bench_hist_print() writes one line of percentiles.  If $BENCH_HIST_DUMP
+// names a file ("-" for stderr) the non-empty buckets are appended to it as
+// "label,low,high,count" CSV rows for plotting.
+
+#ifndef BENCH_HIST_H
+#define BENCH_HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_HIST_SUB_BITS 7
+#define BENCH_HIST_SUB      (1u << BENCH_HIST_SUB_BITS)
+#define BENCH_HIST_BUCKETS  ((64 - BENCH_HIST_SUB_BITS + 1) * BENCH_HIST_SUB)
+
+typedef struct {
+    uint64_t count;
+    uint64_t min, max;
+    long double sum;
+    uint64_t bucket[BENCH_HIST_BUCKETS];
+} bench_hist_t;
+
+static inline void bench_hist_init(bench_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+static inline unsigned bench_hist_index(uint64_t v) {
+    if (v < BENCH_HIST_SUB) return (unsigned)v;
+    unsigned e = 63u - (unsigned)__builtin_clzll(v);   // e >= SUB_BITS
+    unsigned sub = (unsigned)(v >> (e - BENCH_HIST_SUB_BITS)) & (BENCH_HIST_SUB - 1);
+    return (e - BENCH_HIST_SUB_BITS + 1) * BENCH_HIST_SUB + sub;
+}
+
+// Smallest value that lands in bucket idx
+static inline uint64_t bench_hist_low(unsigned idx) {
+    if (idx < BENCH_HIST_SUB) return idx;
+    unsigned shift = idx / BENCH_HIST_SUB - 1;
+    return (uint64_t)(BENCH_HIST_SUB + idx % BENCH_HIST_SUB) << shift;
+}
+
+// Largest value that lands in bucket idx
+static inline uint64_t bench_hist_high(unsigned idx) {
+    if (idx < BENCH_HIST_SUB) return idx;
+    unsigned shift = idx / BENCH_HIST_SUB - 1;
+    return bench_hist_low(idx) + ((uint64_t)1 << shift) - 1;
+}
+
+static inline void bench_hist_record(bench_hist_t *h, uint64_t v) {
+    h->bucket[bench_hist_index(v)]++;
+    h->count++;
+    h->sum += v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+static inline void bench_hist_merge(bench_hist_t *dst, const bench_hist_t *src) {
+    for (unsigned i = 0; i < BENCH_HIST_BUCKETS; ++i) dst->bucket[i] += src->bucket[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+// Value at percentile pct (0..100): upper edge of the bucket holding that
+// rank, clamped to the exact min/max
+static inline uint64_t bench_hist_value_at(const bench_hist_t *h, double pct) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)h->count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > h->count) rank = h->count;
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < BENCH_HIST_BUCKETS; ++i) {
+        seen += h->bucket[i];
+        if (seen >= rank) {
+            uint64_t v = bench_hist_high(i);
+            if (v > h->max) v = h->max;
+            if (v < h->min) v = h->min;
+            return v;
+        }
+    }
+    return h->max;
+}
+
+static inline double bench_hist_mean(const bench_hist_t *h) {
+    return h->count ? (double)(h->sum / h->count) : 0.0;
+}
+
+static inline void bench_hist_dump(const bench_hist_t *h, const char *label, const char *path) {
+    FILE *f = strcmp(path, "-") == 0 ? stderr : fopen(path, "a");
+    if (!f) {
+        perror(path);
+        return;
+    }
+    for (unsigned i = 0; i < BENCH_HIST_BUCKETS; ++i)
+        if (h->bucket[i])
+            fprintf(f, "%s,%llu,%llu,%llu\n", label, (unsigned long long)bench_hist_low(i),
+                    (unsigned long long)bench_hist_high(i), (unsigned long long)h->bucket[i]);
+    if (f != stderr) fclose(f);
+}
+
+// One line of percentiles; values are divided by per (e.g. bytes per run
+// for cycles/byte, 1 for cycles per run)
+static inline void bench_hist_print(const bench_hist_t *h, const char *label, double per) {
+    const char *fmt = per > 1.0 ? "%.3f" : "%.0f";
+    static const double pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+    static const char *names[] = { "p50", "p90", "p99", "p99.9" };
+    const char *dump = getenv("BENCH_HIST_DUMP");
+
+    printf("%s:", label);
+    for (int i = 0; i < 4; ++i) {
+        printf(" %s ", names[i]);
+        printf(fmt, (double)bench_hist_value_at(h, pcts[i]) / per);
+    }
+    printf(" max ");
+    printf(fmt, (double)h->max / per);
+    printf(" (min ");
+    printf(fmt, (double)h->min / per);
+    printf(", %llu runs)\n", (unsigned long long)h->count);
+
+    if (dump && *dump) bench_hist_dump(h, label, dump);
+}
+
+#endif // BENCH_HIST_H
@@ -0,0 +1,164 @@
+// bench_perf.h
+// Optional hardware performance counters around the measured region
+// (Linux perf_event_open, header-only)
+//
+// Set BENCH_PERF=1 to enable.  bench_perf_open() builds one counter group
+// (instructions, cycles, L1D read misses, LLC read misses, branch misses)
+// for user space of the calling thread; members the PMU or the container
+// does not provide are left out and reported as n/a, and if not even the
+// group leader opens the benchmark runs exactly as without BENCH_PERF.
+// bench_perf_start()/bench_perf_stop() enable and disable the whole group
+// with one ioctl each; counts accumulate over all runs and are read once by
+// bench_perf_print().  Call start before bench_tsc_start() and stop after
+// bench_tsc_stop() so the syscalls stay outside the timed interval.
+
+#ifndef BENCH_PERF_H
+#define BENCH_PERF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define BENCH_PERF_EVENTS 5
+
+enum { BENCH_PERF_INSNS, BENCH_PERF_CYCLES, BENCH_PERF_L1D, BENCH_PERF_LLC, BENCH_PERF_BRANCH };
+
+typedef struct {
+    int leader;                         // group leader fd, -1 when disabled
+    int fd[BENCH_PERF_EVENTS];          // -1 for counters that did not open
+    int slot[BENCH_PERF_EVENTS];        // position in the group read, -1 if absent
+    int nr;                             // counters in the group
+} bench_perf_t;
+
+static const char *const bench_perf_names[BENCH_PERF_EVENTS] = {
+    "instructions", "cycles", "L1D misses", "LLC misses", "branch misses"
+};
+
+static inline void bench_perf_attr(int ev, struct perf_event_attr *a) {
+    memset(a, 0, sizeof(*a));
+    a->size = sizeof(*a);
+    a->disabled = 1;
+    a->exclude_kernel = 1;
+    a->exclude_hv = 1;
+    a->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (ev) {
+    case BENCH_PERF_INSNS:
+        a->type = PERF_TYPE_HARDWARE;
+        a->config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case BENCH_PERF_CYCLES:
+        a->type = PERF_TYPE_HARDWARE;
+        a->config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case BENCH_PERF_L1D:
+        a->type = PERF_TYPE_HW_CACHE;
+        a->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case BENCH_PERF_LLC:
+        a->type = PERF_TYPE_HW_CACHE;
+        a->config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    default:
+        a->type = PERF_TYPE_HARDWARE;
+        a->config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+}
+
+static inline int bench_perf_event_open(struct perf_event_attr *a, int group_fd) {
+    return (int)syscall(SYS_perf_event_open, a, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Returns the number of counters opened (0 when disabled or unavailable)
+static inline int bench_perf_open(bench_perf_t *p) {
+    const char *env = getenv("BENCH_PERF");
+    struct perf_event_attr a;
+
+    p->leader = -1;
+    p->nr = 0;
+    for (int i = 0; i < BENCH_PERF_EVENTS; ++i) p->fd[i] = p->slot[i] = -1;
+    if (!env || strcmp(env, "1") != 0) return 0;
+
+    for (int i = 0; i < BENCH_PERF_EVENTS; ++i) {
+        bench_perf_attr(i, &a);
+        int fd = bench_perf_event_open(&a, p->leader);
+        if (fd < 0) {
+            fprintf(stderr, "perf: %s unavailable (%s)\n", bench_perf_names[i], strerror(errno));
+            continue;
+        }
+        if (p->leader < 0) p->leader = fd;
+        p->fd[i] = fd;
+        p->slot[i] = p->nr++;
+    }
+    if (p->leader < 0)
+        fprintf(stderr, "perf: no counters, continuing without them\n");
+    else
+        fprintf(stderr, "perf: %d of %d counters open\n", p->nr, BENCH_PERF_EVENTS);
+    return p->nr;
+}
+
+static inline void bench_perf_start(const bench_perf_t *p) {
+    if (p->leader >= 0) ioctl(p->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static inline void bench_perf_stop(const bench_perf_t *p) {
+    if (p->leader >= 0) ioctl(p->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Accumulated counts, scaled up if the kernel had to multiplex the group;
+// absent counters read as -1.  Returns 0 on success.
+static inline int bench_perf_read(const bench_perf_t *p, double out[BENCH_PERF_EVENTS]) {
+    uint64_t buf[3 + BENCH_PERF_EVENTS];
+
+    for (int i = 0; i < BENCH_PERF_EVENTS; ++i) out[i] = -1.0;
+    if (p->leader < 0) return -1;
+    if (read(p->leader, buf, sizeof(buf)) < (ssize_t)(3 * sizeof(uint64_t))) return -1;
+
+    double scale = (buf[2] > 0 && buf[2] < buf[1]) ? (double)buf[1] / (double)buf[2] : 1.0;
+    for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+        if (p->slot[i] >= 0 && (uint64_t)p->slot[i] < buf[0])
+            out[i] = (double)buf[3 + p->slot[i]] * scale;
+    return 0;
+}
+
+// One line of counts divided by per (bytes processed, or runs); nothing
+// when the counters are not in use
+static inline void bench_perf_fprint(FILE *f, const bench_perf_t *p, const char *label, double per) {
+    double v[BENCH_PERF_EVENTS];
+
+    if (bench_perf_read(p, v) != 0) return;
+    fprintf(f, "%s:", label);
+    for (int i = 0; i < BENCH_PERF_EVENTS; ++i) {
+        if (v[i] < 0)
+            fprintf(f, " %s n/a", bench_perf_names[i]);
+        else
+            fprintf(f, " %s %.4f", bench_perf_names[i], v[i] / per);
+        if (i == BENCH_PERF_CYCLES && v[BENCH_PERF_INSNS] >= 0 && v[i] > 0)
+            fprintf(f, " (IPC %.2f)", v[BENCH_PERF_INSNS] / v[i]);
+        fputs(i + 1 < BENCH_PERF_EVENTS ? "," : "\n", f);
+    }
+}
+
+static inline void bench_perf_print(const bench_perf_t *p, const char *label, double per) {
+    bench_perf_fprint(stdout, p, label, per);
+}
+
+static inline void bench_perf_reset(const bench_perf_t *p) {
+    if (p->leader >= 0) ioctl(p->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+}
+
+static inline void bench_perf_close(bench_perf_t *p) {
+    for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+        if (p->fd[i] >= 0) close(p->fd[i]);
+    p->leader = -1;
+}
+
+#endif // BENCH_PERF_H
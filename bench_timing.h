@@ -0,0 +1,95 @@
+// bench_timing.h
+// Serialized TSC timing for the benchmarks (header-only)
+//
+// bench_tsc_start() executes cpuid before rdtsc so earlier instructions
+// cannot drift into the measured region; bench_tsc_stop() uses rdtscp,
+// which waits for the measured code to finish, then cpuid so later
+// instructions cannot start before the timestamp is taken (the Intel
+// "How to Benchmark Code Execution Times" scheme, as in RSAproject.c).
+//
+// bench_timing_init() measures two things once at startup:
+// - the fixed cost of an empty start/stop pair (minimum over many tries),
+//   which bench_elapsed() subtracts from every interval
+// - the TSC frequency against CLOCK_MONOTONIC_RAW, for bench_ns()
+// It is also called lazily by the first bench_elapsed()/bench_ns().
+
+#ifndef BENCH_TIMING_H
+#define BENCH_TIMING_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_CALIBRATE_PAIRS 10000
+#define BENCH_TSC_SAMPLE_NS   50000000   // 50 ms against the wall clock
+
+static uint64_t bench_overhead;     // cycles of an empty start/stop pair
+static double bench_tsc_ghz;        // TSC ticks per nanosecond
+static int bench_timing_ready;
+
+static inline uint64_t bench_tsc_start(void) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("cpuid\n\t"
+                         "rdtsc\n\t"
+                         "mov %%eax, %0\n\t"
+                         "mov %%edx, %1\n\t"
+                         : "=r"(lo), "=r"(hi)
+                         :
+                         : "%rax", "%rbx", "%rcx", "%rdx", "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t bench_tsc_stop(void) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtscp\n\t"
+                         "mov %%eax, %0\n\t"
+                         "mov %%edx, %1\n\t"
+                         "cpuid\n\t"
+                         : "=r"(lo), "=r"(hi)
+                         :
+                         : "%rax", "%rbx", "%rcx", "%rdx", "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t bench_raw_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void bench_timing_init(void) {
+    if (bench_timing_ready) return;
+
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < BENCH_CALIBRATE_PAIRS; ++i) {
+        uint64_t s = bench_tsc_start();
+        uint64_t e = bench_tsc_stop();
+        if (e - s < best) best = e - s;
+    }
+    bench_overhead = best;
+
+    uint64_t n0 = bench_raw_ns(), c0 = bench_tsc_start(), n1;
+    do {
+        n1 = bench_raw_ns();
+    } while (n1 - n0 < BENCH_TSC_SAMPLE_NS);
+    uint64_t c1 = bench_tsc_stop();
+    bench_tsc_ghz = (double)(c1 - c0) / (double)(n1 - n0);
+    bench_timing_ready = 1;
+
+    fprintf(stderr, "timing: overhead %llu cycles subtracted, TSC %.3f GHz\n",
+            (unsigned long long)bench_overhead, bench_tsc_ghz);
+}
+
+// Cycles between a start/stop pair, measurement overhead removed
+static inline uint64_t bench_elapsed(uint64_t start, uint64_t stop) {
+    if (!bench_timing_ready) bench_timing_init();
+    uint64_t d = stop - start;
+    return d > bench_overhead ? d - bench_overhead : 0;
+}
+
+static inline double bench_ns(double cycles) {
+    if (!bench_timing_ready) bench_timing_init();
+    return cycles / bench_tsc_ghz;
+}
+
+#endif // BENCH_TIMING_H
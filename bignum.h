@@ -0,0 +1,345 @@
+// bignum.h
+// Fixed-width unsigned bignums with Montgomery arithmetic, instantiated
+// at 512, 1024, 2048, 3072 and 4096 bits (header-only)
+//
+// The MR.c Big512 code generalised to any multiple of 64 bits: each width
+// is a separate struct type with its own functions, generated by including
+// bignum_impl.h with BN_BITS set, e.g.
+//
+//   Big2048 n, a, e, r;  MontCtx2048 ctx;
+//   mont2048_init(&ctx, &n);
+//   big2048_powmod(&ctx, &r, &a, &e);      // r = a^e mod n
+//
+// Moduli must be odd.  No heap allocation anywhere; the largest powmod
+// keeps a 16-entry window table, about 8 KB of stack at 4096 bits.
+//
+// From 1024 bits up, bigN_powmod runs on AVX-512 IFMA (radix 2^52, eight
+// limbs per vpmadd52luq/vpmadd52huq) when the CPU has it and falls back
+// to the scalar 64-bit code otherwise.  BN_NO_IFMA=1 in the environment
+// forces the fallback at run time; -DBN_NO_IFMA leaves the IFMA code out.
+
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+
+#define BN_CAT_(a, b)       a##b
+#define BN_CAT(a, b)        BN_CAT_(a, b)
+#define BN_CAT3_(a, b, c)   a##b##c
+#define BN_CAT3(a, b, c)    BN_CAT3_(a, b, c)
+#define BN_UNROLL           _Pragma("GCC unroll 64")
+
+#define BN_WINDOW_MAX 5
+
+// -n^-1 mod 2^64 for odd n; Newton iteration doubles the correct low bits
+static inline uint64_t bn_neg_inv64(uint64_t n0) {
+    uint64_t inv = n0;                   // correct to 3 bits for odd n
+    for (int i = 0; i < 5; i++) inv *= 2 - n0 * inv;
+    return (uint64_t)0 - inv;
+}
+
+// Sliding-window width by exponent length (OpenSSL's break-even points,
+// capped at BN_WINDOW_MAX)
+static inline int bn_window_bits(int bits) {
+    return bits > 239 ? 5 : bits > 79 ? 4 : bits > 23 ? 3 : 1;
+}
+
+// Crossover points in limbs, measured by bignumtune.c on the development
+// machine (Xeon, gcc -O2); rerun it and override with -D on other hardware.
+// Karatsuba recursion applies to even sizes at or above its threshold.
+#ifndef BN_KARATSUBA_MUL_THRESHOLD
+#define BN_KARATSUBA_MUL_THRESHOLD 16
+#endif
+#ifndef BN_KARATSUBA_SQR_THRESHOLD
+#define BN_KARATSUBA_SQR_THRESHOLD 24
+#endif
+// Widths (in limbs) from which Montgomery multiply / square switch from
+// interleaved CIOS to a full product followed by a separate REDC pass
+#ifndef BN_MONT_MUL_THRESHOLD
+#define BN_MONT_MUL_THRESHOLD 32
+#endif
+#ifndef BN_MONT_SQR_THRESHOLD
+#define BN_MONT_SQR_THRESHOLD 16
+#endif
+
+#define BN_MAX_LIMBS   64
+#define BN_KARA_SCRATCH(n) (6 * (n))   // limbs of scratch bn_mul_kara needs
+
+// --- Width-independent limb-vector routines (n limbs each) ---
+
+static inline uint64_t bn_add_n(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+    unsigned char c = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned long long t;
+        c = _addcarry_u64(c, a[i], b[i], &t);
+        r[i] = t;
+    }
+    return c;
+}
+
+static inline uint64_t bn_sub_n(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+    unsigned char c = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned long long t;
+        c = _subborrow_u64(c, a[i], b[i], &t);
+        r[i] = t;
+    }
+    return c;
+}
+
+static inline int bn_cmp_n(const uint64_t *a, const uint64_t *b, int n) {
+    for (int i = n - 1; i >= 0; i--)
+        if (a[i] != b[i]) return a[i] > b[i] ? 1 : -1;
+    return 0;
+}
+
+// r = |a - b|; returns 1 when a < b
+static inline int bn_absdiff(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+    if (bn_cmp_n(a, b, n) >= 0) {
+        bn_sub_n(r, a, b, n);
+        return 0;
+    }
+    bn_sub_n(r, b, a, n);
+    return 1;
+}
+
+// r[2n] = a[n] * b[n], schoolbook; r must not overlap a or b
+static inline void bn_mul_school(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+    memset(r, 0, 2 * n * sizeof(uint64_t));
+    for (int i = 0; i < n; i++) {
+        unsigned __int128 c = 0;
+        uint64_t ai = a[i];
+        for (int j = 0; j < n; j++) {
+            c += (unsigned __int128)ai * b[j] + r[i + j];
+            r[i + j] = (uint64_t)c;
+            c >>= 64;
+        }
+        r[i + n] = (uint64_t)c;
+    }
+}
+
+// r[2n] = a[n]^2: each cross product a[i]*a[j], i < j, once, then doubled,
+// then the squares a[i]^2 on the diagonal
+static inline void bn_sqr_school(uint64_t *r, const uint64_t *a, int n) {
+    memset(r, 0, 2 * n * sizeof(uint64_t));
+    for (int i = 0; i < n - 1; i++) {
+        unsigned __int128 c = 0;
+        uint64_t ai = a[i];
+        for (int j = i + 1; j < n; j++) {
+            c += (unsigned __int128)ai * a[j] + r[i + j];
+            r[i + j] = (uint64_t)c;
+            c >>= 64;
+        }
+        r[i + n] = (uint64_t)c;
+    }
+    uint64_t top = 0;
+    for (int i = 0; i < 2 * n; i++) {
+        uint64_t v = r[i];
+        r[i] = (v << 1) | top;
+        top = v >> 63;
+    }
+    unsigned char c = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned __int128 sq = (unsigned __int128)a[i] * a[i];
+        unsigned long long t;
+        c = _addcarry_u64(c, r[2 * i], (uint64_t)sq, &t);
+        r[2 * i] = t;
+        c = _addcarry_u64(c, r[2 * i + 1], (uint64_t)(sq >> 64), &t);
+        r[2 * i + 1] = t;
+    }
+}
+
+// Add the (n + 1)-limb value cw:w into r[2n] at limb offset h
+static inline void bn_kara_fold(uint64_t *r, const uint64_t *w, uint64_t cw, int h, int n) {
+    uint64_t c = bn_add_n(r + h, r + h, w, n) + cw;
+    for (int i = h + n; c && i < 2 * n; i++) {
+        r[i] += c;
+        c = r[i] < c;
+    }
+}
+
+// r[2n] = a[n] * b[n], Karatsuba down to thr limbs (odd sizes and sizes
+// below thr fall back to schoolbook).  With a = a1 B + a0, b = b1 B + b0:
+// a b = z2 B^2 + (z0 + z2 + (a0 - a1)(b1 - b0)) B + z0.
+// tmp needs BN_KARA_SCRATCH(n) limbs.
+static void bn_mul_kara(uint64_t *r, const uint64_t *a, const uint64_t *b, int n, int thr, uint64_t *tmp) {
+    if (n < thr || (n & 1)) {
+        bn_mul_school(r, a, b, n);
+        return;
+    }
+    int h = n / 2;
+    uint64_t *t = tmp, *u = tmp + h, *p = tmp + n, *w = tmp + 2 * n, *next = tmp + 3 * n;
+
+    bn_mul_kara(r, a, b, h, thr, next);                 // z0
+    bn_mul_kara(r + n, a + h, b + h, h, thr, next);     // z2
+    int neg = bn_absdiff(t, a, a + h, h) ^ bn_absdiff(u, b + h, b, h);
+    bn_mul_kara(p, t, u, h, thr, next);                 // |a0 - a1| |b1 - b0|
+
+    uint64_t cw = bn_add_n(w, r, r + n, n);             // z0 + z2
+    if (neg)
+        cw -= bn_sub_n(w, w, p, n);
+    else
+        cw += bn_add_n(w, w, p, n);
+    bn_kara_fold(r, w, cw, h, n);
+}
+
+// r[2n] = a[n]^2; the middle term is z0 + z2 - (a0 - a1)^2
+static void bn_sqr_kara(uint64_t *r, const uint64_t *a, int n, int thr, uint64_t *tmp) {
+    if (n < thr || (n & 1)) {
+        bn_sqr_school(r, a, n);
+        return;
+    }
+    int h = n / 2;
+    uint64_t *t = tmp, *p = tmp + n, *w = tmp + 2 * n, *next = tmp + 3 * n;
+
+    bn_sqr_kara(r, a, h, thr, next);
+    bn_sqr_kara(r + n, a + h, h, thr, next);
+    bn_absdiff(t, a, a + h, h);
+    bn_sqr_kara(p, t, h, thr, next);
+
+    uint64_t cw = bn_add_n(w, r, r + n, n);
+    cw -= bn_sub_n(w, w, p, n);
+    bn_kara_fold(r, w, cw, h, n);
+}
+
+static inline void bn_mul(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+    uint64_t tmp[BN_KARA_SCRATCH(BN_MAX_LIMBS)];
+    bn_mul_kara(r, a, b, n, BN_KARATSUBA_MUL_THRESHOLD, tmp);
+}
+
+static inline void bn_sqr(uint64_t *r, const uint64_t *a, int n) {
+    uint64_t tmp[BN_KARA_SCRATCH(BN_MAX_LIMBS)];
+    bn_sqr_kara(r, a, n, BN_KARATSUBA_SQR_THRESHOLD, tmp);
+}
+
+// Montgomery reduction of t[2n] (destroyed): r = t R^-1 mod m, for t < m R
+static inline void bn_redc(uint64_t *r, uint64_t *t, const uint64_t *m, uint64_t m0inv, int n) {
+    uint64_t top = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t q = t[i] * m0inv;
+        unsigned __int128 c = 0;
+        for (int j = 0; j < n; j++) {
+            c += (unsigned __int128)q * m[j] + t[i + j];
+            t[i + j] = (uint64_t)c;
+            c >>= 64;
+        }
+        c += (unsigned __int128)t[i + n] + top;
+        t[i + n] = (uint64_t)c;
+        top = (uint64_t)(c >> 64);
+    }
+    if (top || bn_cmp_n(t + n, m, n) >= 0)
+        bn_sub_n(r, t + n, m, n);
+    else
+        memcpy(r, t + n, n * sizeof(uint64_t));
+}
+
+#ifndef BN_NO_IFMA
+// --- AVX-512 IFMA, radix 2^52 ---
+// Operands are arrays of 8 * nv normalised 52-bit limbs (zero above the
+// l significant ones).  The code is compiled for the IFMA target via
+// attributes, so no -m flags are needed; call it only when
+// bn_have_ifma() says so.
+
+#define BN_IFMA_FN      __attribute__((target("avx512f,avx512ifma")))
+#define BN_IFMA_KERNEL  __attribute__((target("avx512f,avx512ifma"), always_inline))
+#define BN_MASK52       ((1ULL << 52) - 1)
+#define BN_IFMA_MAXV    10      // vectors per operand at 4096 bits (79 limbs)
+
+static inline int bn_have_ifma(void) {
+    static int have = -1;
+    if (have < 0) {
+        const char *env = getenv("BN_NO_IFMA");
+        __builtin_cpu_init();
+        have = __builtin_cpu_supports("avx512ifma") && !(env && strcmp(env, "1") == 0);
+    }
+    return have;
+}
+
+// r[l] = a[n] in 52-bit limbs (a < 2^(52 l))
+static inline void bn_to52(uint64_t *r, const uint64_t *a, int n, int l) {
+    for (int i = 0; i < l; i++) {
+        int bit = 52 * i, w = bit / 64, off = bit % 64;
+        uint64_t v = w < n ? a[w] >> off : 0;
+        if (off > 12 && w + 1 < n) v |= a[w + 1] << (64 - off);
+        r[i] = v & BN_MASK52;
+    }
+}
+
+// r[n] = a[l] from normalised 52-bit limbs (a < 2^(64 n))
+static inline void bn_from52(uint64_t *r, const uint64_t *a, int n, int l) {
+    memset(r, 0, n * sizeof(uint64_t));
+    for (int i = 0; i < l; i++) {
+        int bit = 52 * i, w = bit / 64, off = bit % 64;
+        if (w < n) r[w] |= a[i] << off;
+        if (off > 12 && w + 1 < n) r[w + 1] |= a[i] >> (64 - off);
+    }
+}
+
+// r = a b 2^(-52 l) mod m, "almost Montgomery": for a, b < 2m and
+// 4m < 2^(52 l) the result is again below 2m, so nothing is subtracted
+// between multiplications.  Word-serial over b; per step the low halves
+// of a b[i] and m q go in first, the accumulator moves down one limb, and
+// the high halves go in at the shifted position.  Lanes are left
+// unnormalised (at most 4 l 2^52 < 2^61) until the end.  k0 = -m^-1 mod
+// 2^52; r may alias a or b.
+static inline BN_IFMA_KERNEL void bn_ifma_amm(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                                              const uint64_t *m, uint64_t k0, int l, int nv) {
+    __m512i acc[BN_IFMA_MAXV], av[BN_IFMA_MAXV], mv[BN_IFMA_MAXV];
+    const __m512i zero = _mm512_setzero_si512();
+    uint64_t t[8 * BN_IFMA_MAXV];
+
+    BN_UNROLL
+    for (int v = 0; v < nv; v++) {
+        acc[v] = zero;
+        av[v] = _mm512_loadu_si512(a + 8 * v);
+        mv[v] = _mm512_loadu_si512(m + 8 * v);
+    }
+    for (int i = 0; i < l; i++) {
+        __m512i bi = _mm512_set1_epi64((long long)b[i]);
+        BN_UNROLL
+        for (int v = 0; v < nv; v++) acc[v] = _mm512_madd52lo_epu64(acc[v], av[v], bi);
+
+        uint64_t x0 = (uint64_t)_mm_cvtsi128_si64(_mm512_castsi512_si128(acc[0]));
+        uint64_t q = (x0 * k0) & BN_MASK52;
+        uint64_t carry = (x0 + ((q * m[0]) & BN_MASK52)) >> 52;
+        __m512i qv = _mm512_set1_epi64((long long)q);
+        BN_UNROLL
+        for (int v = 0; v < nv; v++) acc[v] = _mm512_madd52lo_epu64(acc[v], mv[v], qv);
+
+        BN_UNROLL
+        for (int v = 0; v < nv - 1; v++) acc[v] = _mm512_alignr_epi64(acc[v + 1], acc[v], 1);
+        acc[nv - 1] = _mm512_alignr_epi64(zero, acc[nv - 1], 1);
+        acc[0] = _mm512_mask_add_epi64(acc[0], 1, acc[0], _mm512_set1_epi64((long long)carry));
+
+        BN_UNROLL
+        for (int v = 0; v < nv; v++) {
+            acc[v] = _mm512_madd52hi_epu64(acc[v], av[v], bi);
+            acc[v] = _mm512_madd52hi_epu64(acc[v], mv[v], qv);
+        }
+    }
+    BN_UNROLL
+    for (int v = 0; v < nv; v++) _mm512_storeu_si512(t + 8 * v, acc[v]);
+    uint64_t c = 0;
+    for (int i = 0; i < 8 * nv; i++) {
+        c += t[i];
+        r[i] = c & BN_MASK52;
+        c >>= 52;
+    }
+}
+#endif // BN_NO_IFMA
+
+#define BN_BITS 512
+#include "bignum_impl.h"
+#define BN_BITS 1024
+#include "bignum_impl.h"
+#define BN_BITS 2048
+#include "bignum_impl.h"
+#define BN_BITS 3072
+#include "bignum_impl.h"
+#define BN_BITS 4096
+#include "bignum_impl.h"
+
+#endif // BIGNUM_H
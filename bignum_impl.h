@@ -0,0 +1,332 @@
+// bignum_impl.h
+// One width of the fixed-limb bignum in bignum.h; included once per width
+// with BN_BITS defined, so there is deliberately no include guard.
+//
+// For BN_BITS = 2048 this defines Big2048, MontCtx2048 and big2048_*,
+// mont2048_* functions.  Every operand is a stack value of BN_BITS / 64
+// limbs (little-endian, v[0] least significant); the limb count is a
+// compile-time constant, so the add/sub/compare loops unroll completely.
+
+#ifndef BN_BITS
+#error "define BN_BITS before including bignum_impl.h"
+#endif
+
+#define BN_N      (BN_BITS / 64)
+#define BN_T      BN_CAT(Big, BN_BITS)
+#define BN_MONT   BN_CAT(MontCtx, BN_BITS)
+#define BN_FN(f)  BN_CAT3(big, BN_BITS, _##f)
+#define MONT_FN(f) BN_CAT3(mont, BN_BITS, _##f)
+
+#if !defined(BN_NO_IFMA) && BN_BITS >= 1024
+#define BN_L52    ((BN_BITS + 2 + 51) / 52)   // 52-bit limbs with 4n < 2^(52 BN_L52)
+#define BN_V52    ((BN_L52 + 7) / 8)          // zmm vectors per operand
+#endif
+
+typedef struct {
+    uint64_t v[BN_N];
+} BN_T;
+
+typedef struct {
+    BN_T n;          // odd modulus
+    uint64_t n0inv;  // -n^-1 mod 2^64
+    BN_T r2;         // R^2 mod n (R = 2^BN_BITS)
+    BN_T one;        // R mod n, i.e. 1 in Montgomery form
+#ifdef BN_L52
+    uint64_t n52[8 * BN_V52];   // n in radix 2^52
+    uint64_t rr52[8 * BN_V52];  // R'^2 mod n in radix 2^52, R' = 2^(52 BN_L52)
+    uint64_t k52;               // -n^-1 mod 2^52
+#endif
+} BN_MONT;
+
+static inline void BN_FN(zero)(BN_T *x) {
+    memset(x->v, 0, sizeof(x->v));
+}
+
+static inline void BN_FN(copy)(BN_T *dst, const BN_T *src) {
+    memcpy(dst->v, src->v, sizeof(dst->v));
+}
+
+static inline void BN_FN(set_u64)(BN_T *x, uint64_t a) {
+    BN_FN(zero)(x);
+    x->v[0] = a;
+}
+
+// -1, 0, 1; branch-free scan of all limbs from the top
+static inline int BN_FN(cmp)(const BN_T *a, const BN_T *b) {
+    int r = 0;
+    BN_UNROLL
+    for (int i = BN_N - 1; i >= 0; i--) {
+        int gt = a->v[i] > b->v[i], lt = a->v[i] < b->v[i];
+        r = r ? r : gt - lt;
+    }
+    return r;
+}
+
+// res = a + b, returns the carry out
+static inline uint64_t BN_FN(add)(BN_T *res, const BN_T *a, const BN_T *b) {
+    unsigned char c = 0;
+    BN_UNROLL
+    for (int i = 0; i < BN_N; i++) {
+        unsigned long long t;
+        c = _addcarry_u64(c, a->v[i], b->v[i], &t);
+        res->v[i] = t;
+    }
+    return c;
+}
+
+// res = a - b, returns the borrow out
+static inline uint64_t BN_FN(sub)(BN_T *res, const BN_T *a, const BN_T *b) {
+    unsigned char c = 0;
+    BN_UNROLL
+    for (int i = 0; i < BN_N; i++) {
+        unsigned long long t;
+        c = _subborrow_u64(c, a->v[i], b->v[i], &t);
+        res->v[i] = t;
+    }
+    return c;
+}
+
+static inline int BN_FN(bitlen)(const BN_T *x) {
+    for (int i = BN_N - 1; i >= 0; i--)
+        if (x->v[i]) return i * 64 + 64 - __builtin_clzll(x->v[i]);
+    return 0;
+}
+
+static inline int BN_FN(bit)(const BN_T *x, int i) {
+    return (int)((x->v[i / 64] >> (i % 64)) & 1);
+}
+
+// x = 2x mod n, for x < n
+static inline void BN_FN(dblmod)(BN_T *x, const BN_T *n) {
+    uint64_t top = x->v[BN_N - 1] >> 63;
+    for (int i = BN_N - 1; i > 0; i--)
+        x->v[i] = (x->v[i] << 1) | (x->v[i - 1] >> 63);
+    x->v[0] <<= 1;
+    if (top || BN_FN(cmp)(x, n) >= 0) BN_FN(sub)(x, x, n);
+}
+
+// res = a * b * R^-1 mod n (CIOS), for a, b < n; res may alias a or b
+static inline void MONT_FN(mul_cios)(const BN_MONT *ctx, BN_T *res, const BN_T *a, const BN_T *b) {
+    uint64_t t[BN_N + 2];
+    memset(t, 0, sizeof(t));
+
+    for (int i = 0; i < BN_N; i++) {
+        unsigned __int128 c = 0;
+        uint64_t bi = b->v[i];
+        BN_UNROLL
+        for (int j = 0; j < BN_N; j++) {
+            c += (unsigned __int128)a->v[j] * bi + t[j];
+            t[j] = (uint64_t)c;
+            c >>= 64;
+        }
+        c += t[BN_N];
+        t[BN_N] = (uint64_t)c;
+        t[BN_N + 1] = (uint64_t)(c >> 64);
+
+        uint64_t m = t[0] * ctx->n0inv;
+        c = (unsigned __int128)m * ctx->n.v[0] + t[0];
+        c >>= 64;
+        BN_UNROLL
+        for (int j = 1; j < BN_N; j++) {
+            c += (unsigned __int128)m * ctx->n.v[j] + t[j];
+            t[j - 1] = (uint64_t)c;
+            c >>= 64;
+        }
+        c += t[BN_N];
+        t[BN_N - 1] = (uint64_t)c;
+        t[BN_N] = t[BN_N + 1] + (uint64_t)(c >> 64);
+    }
+
+    BN_T r;
+    memcpy(r.v, t, sizeof(r.v));
+    if (t[BN_N] || BN_FN(cmp)(&r, &ctx->n) >= 0) BN_FN(sub)(&r, &r, &ctx->n);
+    BN_FN(copy)(res, &r);
+}
+
+// Same result as mul_cios via a full (Karatsuba) product and one REDC pass
+static inline void MONT_FN(mul_redc)(const BN_MONT *ctx, BN_T *res, const BN_T *a, const BN_T *b) {
+    uint64_t t[2 * BN_N];
+    bn_mul(t, a->v, b->v, BN_N);
+    bn_redc(res->v, t, ctx->n.v, ctx->n0inv, BN_N);
+}
+
+// res = a^2 R^-1 mod n via the symmetric (Karatsuba) square and one REDC
+static inline void MONT_FN(sqr_redc)(const BN_MONT *ctx, BN_T *res, const BN_T *a) {
+    uint64_t t[2 * BN_N];
+    bn_sqr(t, a->v, BN_N);
+    bn_redc(res->v, t, ctx->n.v, ctx->n0inv, BN_N);
+}
+
+// Multiply and square dispatch on the calibrated thresholds in bignum.h
+static inline void MONT_FN(mul)(const BN_MONT *ctx, BN_T *res, const BN_T *a, const BN_T *b) {
+#if BN_N >= BN_MONT_MUL_THRESHOLD
+    MONT_FN(mul_redc)(ctx, res, a, b);
+#else
+    MONT_FN(mul_cios)(ctx, res, a, b);
+#endif
+}
+
+static inline void MONT_FN(sqr)(const BN_MONT *ctx, BN_T *res, const BN_T *a) {
+#if BN_N >= BN_MONT_SQR_THRESHOLD
+    MONT_FN(sqr_redc)(ctx, res, a);
+#else
+    MONT_FN(mul_cios)(ctx, res, a, a);
+#endif
+}
+
+// Per-modulus precomputation: n', R mod n and R^2 mod n
+static inline void MONT_FN(init)(BN_MONT *ctx, const BN_T *n) {
+    BN_T x;
+    BN_FN(copy)(&ctx->n, n);
+    ctx->n0inv = bn_neg_inv64(n->v[0]);
+
+    // R mod n: R - n when the top bit of n is set, else by doubling
+    if (n->v[BN_N - 1] >> 63) {
+        BN_FN(zero)(&x);
+        BN_FN(sub)(&x, &x, n);
+    } else {
+        BN_FN(set_u64)(&x, 1);
+        for (int i = 0; i < BN_BITS; i++) BN_FN(dblmod)(&x, n);
+    }
+    BN_FN(copy)(&ctx->one, &x);
+
+    // R^2 = R * 2^(s * 2^j) with BN_BITS = s * 2^j, s odd: s doublings give
+    // R * 2^s, and each Montgomery squaring doubles the exponent of 2
+    int s = BN_BITS, j = 0;
+    while (!(s & 1)) {
+        s >>= 1;
+        j++;
+    }
+    for (int i = 0; i < s; i++) BN_FN(dblmod)(&x, n);
+    for (int i = 0; i < j; i++) MONT_FN(sqr)(ctx, &x, &x);
+    BN_FN(copy)(&ctx->r2, &x);
+
+#ifdef BN_L52
+    // R'^2 = R^2 * 2^(104 BN_L52 - 2 BN_BITS): a few more doublings
+    for (int i = 0; i < 104 * BN_L52 - 2 * BN_BITS; i++) BN_FN(dblmod)(&x, n);
+    bn_to52(ctx->n52, n->v, BN_N, 8 * BN_V52);
+    bn_to52(ctx->rr52, x.v, BN_N, 8 * BN_V52);
+    ctx->k52 = ctx->n0inv & BN_MASK52;
+#endif
+}
+
+static inline void MONT_FN(to)(const BN_MONT *ctx, BN_T *res, const BN_T *a) {
+    MONT_FN(mul)(ctx, res, a, &ctx->r2);
+}
+
+static inline void MONT_FN(from)(const BN_MONT *ctx, BN_T *res, const BN_T *a) {
+    BN_T one;
+    BN_FN(set_u64)(&one, 1);
+    MONT_FN(mul)(ctx, res, a, &one);
+}
+
+// res = base^exp with base and res in Montgomery form; left-to-right
+// sliding window over the odd powers base^1, base^3 .. base^(2^w - 1)
+static inline void MONT_FN(powmod)(const BN_MONT *ctx, BN_T *res, const BN_T *base, const BN_T *exp) {
+    BN_T table[1 << (BN_WINDOW_MAX - 1)], b2, result;
+    int bits = BN_FN(bitlen)(exp), w = bn_window_bits(bits), started = 0;
+
+    BN_FN(copy)(&table[0], base);
+    if (w > 1) {
+        MONT_FN(sqr)(ctx, &b2, base);
+        for (int k = 1; k < (1 << (w - 1)); k++) MONT_FN(mul)(ctx, &table[k], &table[k - 1], &b2);
+    }
+
+    BN_FN(copy)(&result, &ctx->one);
+    for (int i = bits - 1; i >= 0; ) {
+        if (!BN_FN(bit)(exp, i)) {
+            if (started) MONT_FN(sqr)(ctx, &result, &result);
+            i--;
+            continue;
+        }
+        int j = i - w + 1 < 0 ? 0 : i - w + 1;
+        while (!BN_FN(bit)(exp, j)) j++;
+        unsigned win = 0;
+        for (int k = i; k >= j; k--) win = (win << 1) | (unsigned)BN_FN(bit)(exp, k);
+        if (started) {
+            for (int k = 0; k < i - j + 1; k++) MONT_FN(sqr)(ctx, &result, &result);
+            MONT_FN(mul)(ctx, &result, &result, &table[win >> 1]);
+        } else {
+            BN_FN(copy)(&result, &table[win >> 1]);
+            started = 1;
+        }
+        i = j - 1;
+    }
+    BN_FN(copy)(res, &result);
+}
+
+// res = base^exp mod n for plain (non-Montgomery) base < n, 64-bit limbs
+static inline void BN_FN(powmod_scalar)(const BN_MONT *ctx, BN_T *res, const BN_T *base, const BN_T *exp) {
+    BN_T b;
+    MONT_FN(to)(ctx, &b, base);
+    MONT_FN(powmod)(ctx, &b, &b, exp);
+    MONT_FN(from)(ctx, res, &b);
+}
+
+#ifdef BN_L52
+static inline BN_IFMA_FN void MONT_FN(mul52)(const BN_MONT *ctx, uint64_t *r, const uint64_t *a, const uint64_t *b) {
+    bn_ifma_amm(r, a, b, ctx->n52, ctx->k52, BN_L52, BN_V52);
+}
+
+// Same as powmod_scalar on AVX-512 IFMA: the same sliding window, with
+// every value kept below 2n in radix 2^52 and reduced once at the end
+static BN_IFMA_FN void BN_FN(powmod_ifma)(const BN_MONT *ctx, BN_T *res, const BN_T *base, const BN_T *exp) {
+    uint64_t table[1 << (BN_WINDOW_MAX - 1)][8 * BN_V52], b2[8 * BN_V52], result[8 * BN_V52];
+    uint64_t one[8 * BN_V52] = { 1 };
+    int bits = BN_FN(bitlen)(exp), w = bn_window_bits(bits), started = 0;
+
+    bn_to52(result, base->v, BN_N, 8 * BN_V52);
+    MONT_FN(mul52)(ctx, table[0], result, ctx->rr52);
+    if (w > 1) {
+        MONT_FN(mul52)(ctx, b2, table[0], table[0]);
+        for (int k = 1; k < (1 << (w - 1)); k++) MONT_FN(mul52)(ctx, table[k], table[k - 1], b2);
+    }
+
+    MONT_FN(mul52)(ctx, result, ctx->rr52, one);            // R' mod n, for exp = 0
+    for (int i = bits - 1; i >= 0; ) {
+        if (!BN_FN(bit)(exp, i)) {
+            if (started) MONT_FN(mul52)(ctx, result, result, result);
+            i--;
+            continue;
+        }
+        int j = i - w + 1 < 0 ? 0 : i - w + 1;
+        while (!BN_FN(bit)(exp, j)) j++;
+        unsigned win = 0;
+        for (int k = i; k >= j; k--) win = (win << 1) | (unsigned)BN_FN(bit)(exp, k);
+        if (started) {
+            for (int k = 0; k < i - j + 1; k++) MONT_FN(mul52)(ctx, result, result, result);
+            MONT_FN(mul52)(ctx, result, result, table[win >> 1]);
+        } else {
+            memcpy(result, table[win >> 1], sizeof(result));
+            started = 1;
+        }
+        i = j - 1;
+    }
+
+    // Out of Montgomery form; multiplying by 1 leaves a value <= n
+    MONT_FN(mul52)(ctx, result, result, one);
+    bn_from52(res->v, result, BN_N, BN_L52);
+    if (BN_FN(cmp)(res, &ctx->n) >= 0) BN_FN(sub)(res, res, &ctx->n);
+}
+#endif
+
+// res = base^exp mod n for plain (non-Montgomery) base < n; IFMA when the
+// CPU has it (see bignum.h)
+static inline void BN_FN(powmod)(const BN_MONT *ctx, BN_T *res, const BN_T *base, const BN_T *exp) {
+#ifdef BN_L52
+    if (bn_have_ifma()) {
+        BN_FN(powmod_ifma)(ctx, res, base, exp);
+        return;
+    }
+#endif
+    BN_FN(powmod_scalar)(ctx, res, base, exp);
+}
+
+#undef BN_N
+#undef BN_T
+#undef BN_MONT
+#undef BN_FN
+#undef MONT_FN
+#undef BN_L52
+#undef BN_V52
+#undef BN_BITS
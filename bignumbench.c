@@ -0,0 +1,235 @@
+// bignumbench.c
+// Fixed-width Montgomery powmod (bignum.h) against GMP's mpz_powm at
+// 512, 1024, 2048, 3072 and 4096 bits: random odd modulus with the top bit
+// set, random base below it, full-length random exponent.  Both sides
+// include their per-modulus setup, as mpz_powm does its own internally.
+// Then RSA-2048 private operations (CRT, two 1024-bit exponentiations)
+// per second: scalar bignum.h, AVX-512 IFMA bignum.h and mpz_powm.
+// BN_NO_IFMA=1 makes the per-width table use the scalar code.
+//
+// Compile: gcc -O2 bignumbench.c -o bignumbench -lgmp
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+#include "bignum.h"
+#include "chacha_rng.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_hist.h"
+
+// One benchmark function per width; runs shrink as the cost grows ~n^3
+#define BENCH_WIDTH(BITS, RUNS)                                                        \
+static void bench_##BITS(void) {                                                     \
+    bench_hist_t hist_fixed, hist_gmp;                                               \
+    mpz_t zn, za, ze, zr, zf;                                                         \
+    int mismatches = 0;                                                              \
+    mpz_inits(zn, za, ze, zr, zf, NULL);                                              \
+    bench_hist_init(&hist_fixed);                                                    \
+    bench_hist_init(&hist_gmp);                                                      \
+    for (int i = 0; i < (RUNS); i++) {                                               \
+        Big##BITS n, a, e, r;                                                        \
+        MontCtx##BITS ctx;                                                           \
+        rng_bytes(n.v, sizeof(n.v));                                                 \
+        rng_bytes(a.v, sizeof(a.v));                                                 \
+        rng_bytes(e.v, sizeof(e.v));                                                 \
+        n.v[BITS / 64 - 1] |= 1ULL << 63;                                            \
+        n.v[0] |= 1;                                                                 \
+        e.v[BITS / 64 - 1] |= 1ULL << 63;                                            \
+        if (big##BITS##_cmp(&a, &n) >= 0) big##BITS##_sub(&a, &a, &n);              \
+        mpz_import(zn, BITS / 64, -1, 8, 0, 0, n.v);                                 \
+        mpz_import(za, BITS / 64, -1, 8, 0, 0, a.v);                                 \
+        mpz_import(ze, BITS / 64, -1, 8, 0, 0, e.v);                                 \
+                                                                                     \
+        uint64_t t0 = bench_tsc_start();                                             \
+        mont##BITS##_init(&ctx, &n);                                                 \
+        big##BITS##_powmod(&ctx, &r, &a, &e);                                        \
+        uint64_t t1 = bench_tsc_stop();                                              \
+        bench_hist_record(&hist_fixed, bench_elapsed(t0, t1));                       \
+                                                                                     \
+        t0 = bench_tsc_start();                                                      \
+        mpz_powm(zr, za, ze, zn);                                                    \
+        t1 = bench_tsc_stop();                                                       \
+        bench_hist_record(&hist_gmp, bench_elapsed(t0, t1));                         \
+                                                                                     \
+        mpz_import(zf, BITS / 64, -1, 8, 0, 0, r.v);                                 \
+        mismatches += mpz_cmp(zf, zr) != 0;                                          \
+    }                                                                                \
+    printf("%4d bits: fixed-width %10.0f cycles (%8.1f us), mpz_powm %10.0f cycles,"  \
+           " ratio %.2f%s\n", BITS, bench_hist_mean(&hist_fixed),                    \
+           bench_ns(bench_hist_mean(&hist_fixed)) / 1e3, bench_hist_mean(&hist_gmp), \
+           bench_hist_mean(&hist_fixed) / bench_hist_mean(&hist_gmp),                \
+           mismatches ? "  RESULTS DIFFER" : "");                                    \
+    bench_hist_print(&hist_fixed, "           fixed-width", 1.0);                     \
+    bench_hist_print(&hist_gmp, "           mpz_powm   ", 1.0);                       \
+    mpz_clears(zn, za, ze, zr, zf, NULL);                                             \
+}
+
+BENCH_WIDTH(512, 400)
+BENCH_WIDTH(1024, 200)
+BENCH_WIDTH(2048, 50)
+BENCH_WIDTH(3072, 20)
+BENCH_WIDTH(4096, 10)
+
+#define RSA_RUNS 200
+
+typedef void (*powmod1024_fn)(const MontCtx1024 *, Big1024 *, const Big1024 *, const Big1024 *);
+
+typedef struct {
+    mpz_t p, q, n, e, d, dP, dQ, qInv;
+    Big1024 dP_b, dQ_b;
+    MontCtx1024 ctx_p, ctx_q;
+} rsa2048_t;
+
+static void big1024_from_mpz(Big1024 *x, const mpz_t z) {
+    big1024_zero(x);
+    mpz_export(x->v, NULL, -1, 8, 0, 0, z);
+}
+
+static void big1024_to_mpz(mpz_t z, const Big1024 *x) {
+    mpz_import(z, 16, -1, 8, 0, 0, x->v);
+}
+
+// Two 1024-bit primes with the top two bits set (so n has 2048 bits),
+// e = 65537 and the CRT exponents
+static void rsa2048_keygen(rsa2048_t *k, gmp_randstate_t st) {
+    mpz_t pm1, qm1, phi;
+    mpz_inits(k->p, k->q, k->n, k->e, k->d, k->dP, k->dQ, k->qInv, pm1, qm1, phi, NULL);
+    mpz_set_ui(k->e, 65537);
+    do {
+        for (int i = 0; i < 2; i++) {
+            mpz_ptr x = i ? k->q : k->p;
+            mpz_urandomb(x, st, 1024);
+            mpz_setbit(x, 1023);
+            mpz_setbit(x, 1022);
+            mpz_nextprime(x, x);
+        }
+        mpz_sub_ui(pm1, k->p, 1);
+        mpz_sub_ui(qm1, k->q, 1);
+        mpz_mul(phi, pm1, qm1);
+    } while (mpz_cmp(k->p, k->q) == 0 || mpz_sizeinbase(k->p, 2) != 1024 ||
+             mpz_sizeinbase(k->q, 2) != 1024 || !mpz_invert(k->d, k->e, phi));
+    mpz_mul(k->n, k->p, k->q);
+    mpz_mod(k->dP, k->d, pm1);
+    mpz_mod(k->dQ, k->d, qm1);
+    mpz_invert(k->qInv, k->q, k->p);
+
+    Big1024 b;
+    big1024_from_mpz(&b, k->p);
+    mont1024_init(&k->ctx_p, &b);
+    big1024_from_mpz(&b, k->q);
+    mont1024_init(&k->ctx_q, &b);
+    big1024_from_mpz(&k->dP_b, k->dP);
+    big1024_from_mpz(&k->dQ_b, k->dQ);
+    mpz_clears(pm1, qm1, phi, NULL);
+}
+
+// Garner: m = mq + q (qInv (mp - mq) mod p)
+static void rsa_garner(mpz_t m, const mpz_t mp, const mpz_t mq, const rsa2048_t *k) {
+    mpz_sub(m, mp, mq);
+    mpz_mul(m, m, k->qInv);
+    mpz_mod(m, m, k->p);
+    mpz_mul(m, m, k->q);
+    mpz_add(m, m, mq);
+}
+
+// m = c^d mod n with the half-size exponentiations done by f
+static void rsa_decrypt_fixed(powmod1024_fn f, mpz_t m, const mpz_t c, const rsa2048_t *k, mpz_t mp, mpz_t mq) {
+    Big1024 x, r;
+    mpz_mod(mp, c, k->p);
+    big1024_from_mpz(&x, mp);
+    f(&k->ctx_p, &r, &x, &k->dP_b);
+    big1024_to_mpz(mp, &r);
+    mpz_mod(mq, c, k->q);
+    big1024_from_mpz(&x, mq);
+    f(&k->ctx_q, &r, &x, &k->dQ_b);
+    big1024_to_mpz(mq, &r);
+    rsa_garner(m, mp, mq, k);
+}
+
+static void rsa_decrypt_gmp(mpz_t m, const mpz_t c, const rsa2048_t *k, mpz_t mp, mpz_t mq) {
+    mpz_powm(mp, c, k->dP, k->p);
+    mpz_powm(mq, c, k->dQ, k->q);
+    rsa_garner(m, mp, mq, k);
+}
+
+static void bench_rsa2048(void) {
+    enum { SCALAR, IFMA, GMP, PATHS };
+    static const char *const names[PATHS] = { "scalar bignum.h", "IFMA bignum.h", "mpz_powm" };
+    bench_hist_t hist[PATHS];
+    gmp_randstate_t st;
+    rsa2048_t k;
+    mpz_t c, m[PATHS], check, mp, mq;
+    unsigned long seed;
+    int mismatches = 0;
+    int have_ifma = 0;
+
+#ifndef BN_NO_IFMA
+    have_ifma = bn_have_ifma();
+#endif
+    rng_bytes(&seed, sizeof(seed));
+    gmp_randinit_default(st);
+    gmp_randseed_ui(st, seed);
+    rsa2048_keygen(&k, st);
+    mpz_inits(c, m[SCALAR], m[IFMA], m[GMP], check, mp, mq, NULL);
+    for (int p = 0; p < PATHS; p++) bench_hist_init(&hist[p]);
+
+    for (int i = 0; i < RSA_RUNS; i++) {
+        mpz_urandomm(c, st, k.n);
+        for (int p = 0; p < PATHS; p++) {
+            if (p == IFMA && !have_ifma) continue;
+            uint64_t t0 = bench_tsc_start();
+            if (p == GMP)
+                rsa_decrypt_gmp(m[p], c, &k, mp, mq);
+            else
+#ifndef BN_NO_IFMA
+                rsa_decrypt_fixed(p == IFMA ? big1024_powmod_ifma : big1024_powmod_scalar, m[p], c, &k, mp, mq);
+#else
+                rsa_decrypt_fixed(big1024_powmod_scalar, m[p], c, &k, mp, mq);
+#endif
+            uint64_t t1 = bench_tsc_stop();
+            bench_hist_record(&hist[p], bench_elapsed(t0, t1));
+        }
+        mpz_powm(check, m[GMP], k.e, k.n);
+        mismatches += mpz_cmp(check, c) != 0 || mpz_cmp(m[SCALAR], m[GMP]) != 0 ||
+                      (have_ifma && mpz_cmp(m[IFMA], m[GMP]) != 0);
+    }
+
+    printf("\nRSA-2048 private operation (CRT), %d runs%s\n", RSA_RUNS,
+           mismatches ? "  RESULTS DIFFER" : "");
+    for (int p = 0; p < PATHS; p++) {
+        if (p == IFMA && !have_ifma) {
+            printf("  %-16s not available (no IFMA or BN_NO_IFMA)\n", names[p]);
+            continue;
+        }
+        double mean = bench_hist_mean(&hist[p]);
+        printf("  %-16s %10.0f cycles (%7.1f us), %7.0f ops/s, %.2fx mpz_powm\n", names[p], mean,
+               bench_ns(mean) / 1e3, 1e9 / bench_ns(mean), bench_hist_mean(&hist[GMP]) / mean);
+    }
+    for (int p = 0; p < PATHS; p++)
+        if (p != IFMA || have_ifma) bench_hist_print(&hist[p], names[p], 1.0);
+
+    mpz_clears(c, m[SCALAR], m[IFMA], m[GMP], check, mp, mq, NULL);
+    mpz_clears(k.p, k.q, k.n, k.e, k.d, k.dP, k.dQ, k.qInv, NULL);
+    gmp_randclear(st);
+}
+
+int main() {
+    bench_isolate(0);
+    bench_timing_init();
+
+    printf("Modular exponentiation, full-length exponent (ratio < 1: fixed-width is faster)\n");
+#ifndef BN_NO_IFMA
+    if (bn_have_ifma()) printf("(1024 bits and up on AVX-512 IFMA)\n");
+#endif
+    bench_512();
+    bench_1024();
+    bench_2048();
+    bench_3072();
+    bench_4096();
+    bench_rsa2048();
+    return 0;
+}
@@ -0,0 +1,135 @@
+// bignumtune.c
+// Calibrates the multiplication thresholds in bignum.h on this machine and
+// prints them as #defines to paste back (or pass with -D):
+// - BN_KARATSUBA_MUL/SQR_THRESHOLD: smallest even size n (limbs) from which
+//   one Karatsuba level over schoolbook halves beats schoolbook at n and at
+//   the following sizes
+// - BN_MONT_MUL/SQR_THRESHOLD: smallest width (8..64 limbs) from which a
+//   full product + REDC beats the interleaved CIOS loop
+// Each figure is the minimum over TRIALS timings of REPS operations.
+//
+// Compile: gcc -O2 bignumtune.c -o bignumtune
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bignum.h"
+#include "chacha_rng.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+
+#define TRIALS 41
+#define REPS   100
+#define CONFIRM 3        // sizes in a row that must agree before accepting
+
+static uint64_t sink;
+
+// Minimum cycles per call of expression OP over TRIALS x REPS
+#define MIN_CYCLES(result, OP) do {                                   \
+    uint64_t best = UINT64_MAX;                                       \
+    for (int tr = 0; tr < TRIALS; tr++) {                             \
+        uint64_t t0 = bench_tsc_start();                              \
+        for (int rp = 0; rp < REPS; rp++) { OP; }                     \
+        uint64_t c = bench_elapsed(t0, bench_tsc_stop());             \
+        if (c < best) best = c;                                       \
+    }                                                                 \
+    (result) = (double)best / REPS;                                   \
+} while (0)
+
+// Smallest n in sizes[] from which faster[] < slower[] for CONFIRM sizes
+// in a row (or to the end of the table); 0 if never
+static int crossover(const int *sizes, const double *slower, const double *faster, int count) {
+    for (int i = 0; i < count; i++) {
+        int ok = 1;
+        for (int k = i; k < count && k < i + CONFIRM; k++)
+            if (faster[k] >= slower[k]) ok = 0;
+        if (ok) return sizes[i];
+    }
+    return 0;
+}
+
+int main() {
+    bench_isolate(0);
+    bench_timing_init();
+
+    static uint64_t a[BN_MAX_LIMBS], b[BN_MAX_LIMBS], r[2 * BN_MAX_LIMBS];
+    static uint64_t tmp[BN_KARA_SCRATCH(BN_MAX_LIMBS)];
+    int sizes[BN_MAX_LIMBS];
+    double school_mul[BN_MAX_LIMBS], kara_mul[BN_MAX_LIMBS];
+    double school_sqr[BN_MAX_LIMBS], kara_sqr[BN_MAX_LIMBS];
+    int count = 0;
+
+    rng_bytes(a, sizeof(a));
+    rng_bytes(b, sizeof(b));
+
+    printf("%6s %14s %14s %14s %14s\n", "limbs", "school mul", "karatsuba mul", "school sqr", "karatsuba sqr");
+    for (int n = 4; n <= BN_MAX_LIMBS; n += 2, count++) {
+        sizes[count] = n;
+        MIN_CYCLES(school_mul[count], bn_mul_school(r, a, b, n); sink += r[n]);
+        MIN_CYCLES(kara_mul[count], bn_mul_kara(r, a, b, n, n, tmp); sink += r[n]);
+        MIN_CYCLES(school_sqr[count], bn_sqr_school(r, a, n); sink += r[n]);
+        MIN_CYCLES(kara_sqr[count], bn_sqr_kara(r, a, n, n, tmp); sink += r[n]);
+        printf("%6d %14.0f %14.0f %14.0f %14.0f\n", n, school_mul[count], kara_mul[count],
+               school_sqr[count], kara_sqr[count]);
+    }
+    int kmul = crossover(sizes, school_mul, kara_mul, count);
+    int ksqr = crossover(sizes, school_sqr, kara_sqr, count);
+    if (!kmul) kmul = BN_MAX_LIMBS + 1;
+    if (!ksqr) ksqr = BN_MAX_LIMBS + 1;
+
+    // Montgomery: CIOS (per width) against the full product with the
+    // thresholds just measured, followed by REDC
+    static const int widths[] = { 8, 16, 32, 48, 64 };
+    double cios_mul[5], redc_mul[5], cios_sqr[5], redc_sqr[5];
+    uint64_t n0inv;
+
+    printf("\n%6s %14s %14s %14s %14s\n", "limbs", "CIOS mul", "mul + REDC", "CIOS sqr", "sqr + REDC");
+    for (int w = 0; w < 5; w++) {
+        int n = widths[w];
+        uint64_t m[BN_MAX_LIMBS], t[2 * BN_MAX_LIMBS];
+        rng_bytes(m, sizeof(m));
+        m[0] |= 1;
+        m[n - 1] |= 1ULL << 63;
+        a[n - 1] &= ~(1ULL << 63);                       // a, b < m
+        b[n - 1] &= ~(1ULL << 63);
+        n0inv = bn_neg_inv64(m[0]);
+
+#define CIOS_CASE(BITS)                                                               \
+        case BITS / 64: {                                                             \
+            MontCtx##BITS ctx;                                                        \
+            Big##BITS x, y, z;                                                        \
+            memcpy(ctx.n.v, m, sizeof(ctx.n.v));                                      \
+            ctx.n0inv = n0inv;                                                        \
+            memcpy(x.v, a, sizeof(x.v));                                              \
+            memcpy(y.v, b, sizeof(y.v));                                              \
+            MIN_CYCLES(cios_mul[w], mont##BITS##_mul_cios(&ctx, &z, &x, &y); sink += z.v[0]); \
+            MIN_CYCLES(cios_sqr[w], mont##BITS##_mul_cios(&ctx, &z, &x, &x); sink += z.v[0]); \
+            break;                                                                    \
+        }
+        switch (n) {
+        CIOS_CASE(512)
+        CIOS_CASE(1024)
+        CIOS_CASE(2048)
+        CIOS_CASE(3072)
+        CIOS_CASE(4096)
+        }
+        MIN_CYCLES(redc_mul[w], bn_mul_kara(t, a, b, n, kmul, tmp); bn_redc(r, t, m, n0inv, n); sink += r[0]);
+        MIN_CYCLES(redc_sqr[w], bn_sqr_kara(t, a, n, ksqr, tmp); bn_redc(r, t, m, n0inv, n); sink += r[0]);
+        printf("%6d %14.0f %14.0f %14.0f %14.0f\n", n, cios_mul[w], redc_mul[w], cios_sqr[w], redc_sqr[w]);
+    }
+    int mmul = crossover(widths, cios_mul, redc_mul, 5);
+    int msqr = crossover(widths, cios_sqr, redc_sqr, 5);
+    if (!mmul) mmul = BN_MAX_LIMBS + 1;
+    if (!msqr) msqr = BN_MAX_LIMBS + 1;
+
+    printf("\n// bignumtune.c on this machine (compiled-in values: %d %d %d %d)\n",
+           BN_KARATSUBA_MUL_THRESHOLD, BN_KARATSUBA_SQR_THRESHOLD, BN_MONT_MUL_THRESHOLD, BN_MONT_SQR_THRESHOLD);
+    printf("#define BN_KARATSUBA_MUL_THRESHOLD %d\n", kmul);
+    printf("#define BN_KARATSUBA_SQR_THRESHOLD %d\n", ksqr);
+    printf("#define BN_MONT_MUL_THRESHOLD %d\n", mmul);
+    printf("#define BN_MONT_SQR_THRESHOLD %d\n", msqr);
+    printf("(sink %llu)\n", (unsigned long long)(sink & 1));
+    return 0;
+}
@@ -1,7 +1,28 @@
+// chacha20.c
+// ChaCha20 (RFC 8439) stream tool: encrypts/decrypts files or pipes through a
+// three-slot pipeline so reading, keystream XOR and writing overlap.
+// Output is raw binary unless -x is given.
+//
+// Compile: gcc -O2 -pthread chacha20.c -o chacha20
+// Usage:   chacha20 -k <64 hex> -n <24 hex> [in|-] [out|-]
+
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <emmintrin.h>
+#include "keystream.h"
+
+#define STREAM_BUF_SIZE (4u << 20)  // bytes per pipeline slot, multiple of 64
+#define STREAM_SLOTS    3           // one being read, one encrypted, one written
+#define STREAM_ALIGN    64
 
 #define ROTL(a,b) (((a) << (b)) | ((a) >> (32 - (b))))
 #define QR(a,b,c,d) \
@@ -36,12 +57,40 @@ static uint32_t load32_le(const uint8_t *src)
            ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
 }
 
-static void store32_le(uint8_t *dst, uint32_t w) 
+void chacha20_setup(uint32_t state[16], const uint8_t key[32], const uint8_t nonce[12], uint32_t counter)
 {
-    dst[0] = w & 0xff;
-    dst[1] = (w >> 8) & 0xff;
-    dst[2] = (w >> 16) & 0xff;
-    dst[3] = (w >> 24) & 0xff;
+    size_t i;
+    state[0] = 0x61707865; state[1] = 0x3320646e;
+    state[2] = 0x79622d32; state[3] = 0x6b206574;
+
+    for (i = 0; i < 8; i++)
+        state[4 + i] = load32_le(key + i * 4);
+
+    state[12] = counter;
+    for (i = 0; i < 3; i++)
+        state[13 + i] = load32_le(nonce + i * 4);
+}
+
+// out = in ^ keystream, widest kernel first; advances the block counter.
+// Only the last call of a stream may end in a partial block.
+void chacha20_xor(uint32_t state[16], uint8_t *out, const uint8_t *in, size_t len)
+{
+    size_t i = 0;
+
+    if (chacha20_have_avx2())
+    {
+        for (; len - i >= 512; i += 512, state[12] += 8)
+            chacha20_xor_blocks8_avx2(out + i, in + i, state);
+    }
+    for (; len - i >= 256; i += 256, state[12] += 4)
+        chacha20_xor_blocks4_sse2(out + i, in + i, state);
+
+    if (i < len)
+    {
+        uint8_t keystream[256] __attribute__((aligned(KEYSTREAM_ALIGN)));
+        chacha20_keystream(keystream, state, (len - i + 63) / 64);
+        keystream_xor(out + i, in + i, keystream, len - i);
+    }
 }
 
 void chacha20_encrypt(
@@ -50,35 +99,347 @@ void chacha20_encrypt(
     uint32_t counter
 ) 
 {
-    uint32_t state[16], block[16];
-    uint8_t keystream[64];
-    size_t i, j;
+    uint32_t state[16];
+    chacha20_setup(state, key, nonce, counter);
+    chacha20_xor(state, out, in, len);
+}
 
-    state[0] = 0x61707865; state[1] = 0x3320646e;
-    state[2] = 0x79622d32; state[3] = 0x6b206574;
+// ---------------------------------------------------------------------------
+// Hex encoding
+// ---------------------------------------------------------------------------
 
-    for (i = 0; i < 8; i++)
-        state[4 + i] = load32_le(key + i * 4);
+// 16 bytes -> 32 lowercase hex digits per iteration
+size_t hex_encode(char *dst, const uint8_t *src, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i alpha = _mm_set1_epi8('a' - '0' - 10);
+    size_t i = 0;
 
-    state[12] = counter;
-    for (i = 0; i < 3; i++)
-        state[13 + i] = load32_le(nonce + i * 4);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        __m128i a = _mm_unpacklo_epi8(hi, lo);
+        __m128i b = _mm_unpackhi_epi8(hi, lo);
+        a = _mm_add_epi8(_mm_add_epi8(a, zero), _mm_and_si128(_mm_cmpgt_epi8(a, nine), alpha));
+        b = _mm_add_epi8(_mm_add_epi8(b, zero), _mm_and_si128(_mm_cmpgt_epi8(b, nine), alpha));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), a);
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), b);
+    }
+    for (; i < len; i++)
+    {
+        dst[2 * i] = digits[src[i] >> 4];
+        dst[2 * i + 1] = digits[src[i] & 0x0f];
+    }
+    return 2 * len;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decode hex text, skipping whitespace; a dangling high nibble is carried
+// to the next call in *carry (-1 = none).  Returns bytes written or -1.
+long hex_decode(uint8_t *dst, const char *src, size_t len, int *carry)
+{
+    long n = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (src[i] == ' ' || src[i] == '\n' || src[i] == '\r' || src[i] == '\t')
+            continue;
+        int v = hex_value(src[i]);
+        if (v < 0) return -1;
+        if (*carry < 0)
+            *carry = v;
+        else
+        {
+            dst[n++] = (uint8_t)((*carry << 4) | v);
+            *carry = -1;
+        }
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Streaming pipeline: reader thread -> encrypt (caller) -> writer thread
+// ---------------------------------------------------------------------------
+
+enum { SLOT_EMPTY, SLOT_FILLED, SLOT_CRYPTED };
+
+typedef struct {
+    uint8_t *data;     // STREAM_BUF_SIZE bytes, 64-byte aligned
+    char *text;        // 2 * STREAM_BUF_SIZE, hex input / output staging
+    size_t len;
+    int state;
+    int eof;           // last slot of the stream
+} stream_slot_t;
+
+typedef struct {
+    int in_fd, out_fd;
+    int hex_in, hex_out;
+    stream_slot_t slot[STREAM_SLOTS];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int error;
+    unsigned long long bytes;
+} stream_t;
+
+// Wait until slot s reaches state want; returns 0, or -1 if another stage failed
+static int stream_wait(stream_t *st, stream_slot_t *s, int want)
+{
+    pthread_mutex_lock(&st->lock);
+    while (s->state != want && !st->error)
+        pthread_cond_wait(&st->cond, &st->lock);
+    int err = st->error;
+    pthread_mutex_unlock(&st->lock);
+    return err ? -1 : 0;
+}
+
+static void stream_post(stream_t *st, stream_slot_t *s, int state, int error)
+{
+    pthread_mutex_lock(&st->lock);
+    s->state = state;
+    if (error) st->error = 1;
+    pthread_cond_broadcast(&st->cond);
+    pthread_mutex_unlock(&st->lock);
+}
+
+// Read up to len bytes, retrying short reads; returns bytes read or -1
+static ssize_t read_full(int fd, void *buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t r = read(fd, (char *)buf + got, len - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return -1;
+        if (r == 0) break;
+        got += (size_t)r;
+    }
+    return (ssize_t)got;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+    size_t put = 0;
+    while (put < len)
+    {
+        ssize_t w = write(fd, (const char *)buf + put, len - put);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) return -1;
+        put += (size_t)w;
+    }
+    return 0;
+}
+
+// Fill one slot; hex input is decoded until the slot is full so that every
+// slot but the last is a whole number of ChaCha20 blocks
+static int stream_fill(stream_t *st, stream_slot_t *s, int *carry)
+{
+    s->len = 0;
+    s->eof = 0;
+    if (!st->hex_in)
+    {
+        ssize_t r = read_full(st->in_fd, s->data, STREAM_BUF_SIZE);
+        if (r < 0)
+        {
+            perror("chacha20: read");
+            return -1;
+        }
+        s->len = (size_t)r;
+        s->eof = (s->len < STREAM_BUF_SIZE);
+        return 0;
+    }
+    while (s->len < STREAM_BUF_SIZE)
+    {
+        size_t want = 2 * (STREAM_BUF_SIZE - s->len) - (*carry >= 0 ? 1 : 0);
+        ssize_t r = read_full(st->in_fd, s->text, want);
+        if (r < 0)
+        {
+            perror("chacha20: read");
+            return -1;
+        }
+        long n = hex_decode(s->data + s->len, s->text, (size_t)r, carry);
+        if (n < 0)
+        {
+            fprintf(stderr, "chacha20: invalid hex input\n");
+            return -1;
+        }
+        s->len += (size_t)n;
+        if ((size_t)r < want)
+        {
+            if (*carry >= 0)
+            {
+                fprintf(stderr, "chacha20: odd number of hex digits\n");
+                return -1;
+            }
+            s->eof = 1;
+            break;
+        }
+    }
+    return 0;
+}
+
+static void *stream_reader(void *arg)
+{
+    stream_t *st = (stream_t *)arg;
+    int carry = -1;
+    for (unsigned long seq = 0;; seq++)
+    {
+        stream_slot_t *s = &st->slot[seq % STREAM_SLOTS];
+        if (stream_wait(st, s, SLOT_EMPTY) != 0) break;
+        int err = stream_fill(st, s, &carry);
+        stream_post(st, s, SLOT_FILLED, err);
+        if (err || s->eof) break;
+    }
+    return NULL;
+}
 
-    for (i = 0; i < len; i += 64) 
+static void *stream_writer(void *arg)
+{
+    stream_t *st = (stream_t *)arg;
+    for (unsigned long seq = 0;; seq++)
     {
-        chacha20_block(block, state);
-        for (j = 0; j < 16; j++)
-            store32_le(keystream + 4 * j, block[j]);
+        stream_slot_t *s = &st->slot[seq % STREAM_SLOTS];
+        if (stream_wait(st, s, SLOT_CRYPTED) != 0) break;
+        int err;
+        if (st->hex_out)
+        {
+            size_t n = hex_encode(s->text, s->data, s->len);
+            if (s->eof) s->text[n++] = '\n';
+            err = write_full(st->out_fd, s->text, n);
+        }
+        else
+            err = write_full(st->out_fd, s->data, s->len);
+        if (err) perror("chacha20: write");
+        int eof = s->eof;
+        stream_post(st, s, SLOT_EMPTY, err);
+        if (err || eof) break;
+    }
+    return NULL;
+}
 
-        size_t block_len = (len - i < 64) ? len - i : 64;
-        for (j = 0; j < block_len; j++)
-            out[i + j] = in[i + j] ^ keystream[j];
+// Encrypt/decrypt in_fd to out_fd; returns 0 on success
+int chacha20_stream(int in_fd, int out_fd, int hex_in, int hex_out,
+                    const uint8_t key[32], const uint8_t nonce[12], uint32_t counter,
+                    unsigned long long *bytes)
+{
+    stream_t st;
+    uint32_t state[16];
+    pthread_t reader, writer;
+    int have_reader = 0, have_writer = 0;
+    int rc = 0;
+
+    memset(&st, 0, sizeof(st));
+    st.in_fd = in_fd;
+    st.out_fd = out_fd;
+    st.hex_in = hex_in;
+    st.hex_out = hex_out;
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.cond, NULL);
+    for (int i = 0; i < STREAM_SLOTS && !st.error; i++)
+    {
+        if (posix_memalign((void **)&st.slot[i].data, STREAM_ALIGN, STREAM_BUF_SIZE) != 0 ||
+            ((hex_in || hex_out) &&
+             posix_memalign((void **)&st.slot[i].text, STREAM_ALIGN, 2 * (size_t)STREAM_BUF_SIZE + 1) != 0))
+        {
+            fprintf(stderr, "chacha20: out of memory\n");
+            st.error = 1;
+        }
+    }
+
+    if (!st.error)
+    {
+        posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        chacha20_setup(state, key, nonce, counter);
+
+        // A stage that does not start fails the stream; the error wakes
+        // whichever stage is already waiting, and the slot states no longer
+        // matter once it is set
+        int err = pthread_create(&reader, NULL, stream_reader, &st);
+        have_reader = (err == 0);
+        if (err == 0)
+        {
+            err = pthread_create(&writer, NULL, stream_writer, &st);
+            have_writer = (err == 0);
+        }
+        if (err != 0)
+        {
+            fprintf(stderr, "chacha20: pthread_create: %s\n", strerror(err));
+            stream_post(&st, &st.slot[0], SLOT_EMPTY, 1);
+        }
+    }
+
+    for (unsigned long seq = 0; have_reader && have_writer; seq++)
+    {
+        stream_slot_t *s = &st.slot[seq % STREAM_SLOTS];
+        if (stream_wait(&st, s, SLOT_FILLED) != 0) break;
+        // 32-bit block counter: refuse to wrap and reuse keystream
+        if ((uint64_t)state[12] + (s->len + 63) / 64 > 0x100000000ULL)
+        {
+            fprintf(stderr, "chacha20: stream exceeds 2^32 blocks for this nonce\n");
+            stream_post(&st, s, SLOT_FILLED, 1);
+            break;
+        }
+        chacha20_xor(state, s->data, s->data, s->len);
+        st.bytes += s->len;
+        int eof = s->eof;
+        stream_post(&st, s, SLOT_CRYPTED, 0);
+        if (eof) break;
+    }
 
-        state[12]++;
+    if (have_reader) pthread_join(reader, NULL);
+    if (have_writer) pthread_join(writer, NULL);
+    rc = st.error;
+    if (bytes) *bytes = st.bytes;
+    for (int i = 0; i < STREAM_SLOTS; i++)
+    {
+        free(st.slot[i].data);
+        free(st.slot[i].text);
     }
+    pthread_mutex_destroy(&st.lock);
+    pthread_cond_destroy(&st.cond);
+    memset(state, 0, sizeof(state));
+    return rc;
+}
+
+// ---------------------------------------------------------------------------
+// Command line
+// ---------------------------------------------------------------------------
+
+static int parse_hex_arg(uint8_t *dst, size_t len, const char *arg)
+{
+    int carry = -1;
+    if (strlen(arg) != 2 * len || hex_decode(dst, arg, 2 * len, &carry) != (long)len)
+        return -1;
+    return 0;
 }
 
-int main() 
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-d] [-x] [-X] [-k key] [-n nonce] [-c counter] [-v] [in [out]]\n"
+        "  in, out     files; omitted or \"-\" means stdin / stdout\n"
+        "  -d          decrypt (same operation as encrypt, for readability)\n"
+        "  -x          write output as hex instead of raw binary\n"
+        "  -X          read input as hex (whitespace ignored)\n"
+        "  -k key      256-bit key, 64 hex digits (default all-zero, demo only)\n"
+        "  -n nonce    96-bit nonce, 24 hex digits (default all-zero)\n"
+        "  -c counter  initial 32-bit block counter (default 0)\n"
+        "  -v          print byte count and throughput to stderr\n"
+        "Run with no arguments on a terminal for the interactive demo.\n", prog);
+}
+
+// Original interactive demo: one line of text
+static int interactive_main(void)
 {
     uint8_t key[32] = {0};   // All-zero 256-bit key
     uint8_t nonce[12] = {0}; // All-zero 96-bit nonce
@@ -114,3 +475,92 @@ int main()
 
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    uint8_t key[32] = {0};
+    uint8_t nonce[12] = {0};
+    uint32_t counter = 0;
+    int hex_in = 0, hex_out = 0, verbose = 0, have_key = 0;
+    int opt;
+
+    if (argc == 1 && isatty(STDIN_FILENO))
+        return interactive_main();
+
+    while ((opt = getopt(argc, argv, "dxXk:n:c:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd': break;
+        case 'x': hex_out = 1; break;
+        case 'X': hex_in = 1; break;
+        case 'k':
+            if (parse_hex_arg(key, sizeof(key), optarg) != 0)
+            {
+                fprintf(stderr, "chacha20: key must be 64 hex digits\n");
+                return 2;
+            }
+            have_key = 1;
+            break;
+        case 'n':
+            if (parse_hex_arg(nonce, sizeof(nonce), optarg) != 0)
+            {
+                fprintf(stderr, "chacha20: nonce must be 24 hex digits\n");
+                return 2;
+            }
+            break;
+        case 'c': counter = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'v': verbose = 1; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (argc - optind > 2)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!have_key)
+        fprintf(stderr, "chacha20: warning: using the all-zero demo key\n");
+
+    int in_fd = STDIN_FILENO, out_fd = STDOUT_FILENO;
+    if (optind < argc && strcmp(argv[optind], "-") != 0)
+    {
+        in_fd = open(argv[optind], O_RDONLY);
+        if (in_fd < 0)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+    if (optind + 1 < argc && strcmp(argv[optind + 1], "-") != 0)
+    {
+        out_fd = open(argv[optind + 1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0)
+        {
+            perror(argv[optind + 1]);
+            return 1;
+        }
+    }
+
+    struct timespec t0, t1;
+    unsigned long long bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int rc = chacha20_stream(in_fd, out_fd, hex_in, hex_out, key, nonce, counter, &bytes);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (out_fd != STDOUT_FILENO && close(out_fd) != 0)
+    {
+        perror("chacha20: close");
+        rc = 1;
+    }
+    if (in_fd != STDIN_FILENO) close(in_fd);
+
+    if (verbose)
+    {
+        double sec = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        fprintf(stderr, "%llu bytes in %.3f s (%.1f MB/s)\n", bytes, sec, sec > 0 ? bytes / sec / 1e6 : 0.0);
+    }
+    return rc ? 1 : 0;
+}
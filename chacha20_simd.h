@@ -0,0 +1,136 @@
+// chacha20_simd.h
+// SSE2 and AVX2 ChaCha20 multi-block kernels (header-only)
+//
+// State layout is RFC 8439: constants x0..x3, key x4..x11, 32-bit block
+// counter x12, nonce x13..x15.  Kernels are word-sliced: vector k holds
+// word k of 4 (SSE2) or 8 (AVX2) consecutive blocks, transposed back to
+// byte order on store.
+//
+// Every kernel computes out = in ^ keystream; pass in == NULL to write the
+// raw keystream instead.  Kernels do not advance the counter in st[].
+
+#ifndef CHACHA20_SIMD_H
+#define CHACHA20_SIMD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#define CHACHA_ROTL_SSE2(v, c) \
+    _mm_or_si128(_mm_slli_epi32((v), (c)), _mm_srli_epi32((v), 32 - (c)))
+#define CHACHA_ROTL_AVX2(v, c) \
+    _mm256_or_si256(_mm256_slli_epi32((v), (c)), _mm256_srli_epi32((v), 32 - (c)))
+
+#define CHACHA_QR_SSE2(a, b, c, d) do { \
+    a = _mm_add_epi32(a, b); d = CHACHA_ROTL_SSE2(_mm_xor_si128(d, a), 16); \
+    c = _mm_add_epi32(c, d); b = CHACHA_ROTL_SSE2(_mm_xor_si128(b, c), 12); \
+    a = _mm_add_epi32(a, b); d = CHACHA_ROTL_SSE2(_mm_xor_si128(d, a), 8);  \
+    c = _mm_add_epi32(c, d); b = CHACHA_ROTL_SSE2(_mm_xor_si128(b, c), 7);  \
+} while (0)
+
+// 16- and 8-bit rotations are byte shuffles on AVX2
+#define CHACHA_QR_AVX2(a, b, c, d, r16, r8) do { \
+    a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), r16); \
+    c = _mm256_add_epi32(c, d); b = CHACHA_ROTL_AVX2(_mm256_xor_si256(b, c), 12);     \
+    a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), r8);  \
+    c = _mm256_add_epi32(c, d); b = CHACHA_ROTL_AVX2(_mm256_xor_si256(b, c), 7);      \
+} while (0)
+
+static inline int chacha20_have_avx2(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return cached;
+}
+
+// Four blocks, counters st[12] .. st[12] + 3
+static inline void chacha20_xor_blocks4_sse2(uint8_t *out, const uint8_t *in, const uint32_t st[16]) {
+    __m128i x[16], s[16];
+    for (int i = 0; i < 16; ++i) s[i] = _mm_set1_epi32((int)st[i]);
+    s[12] = _mm_add_epi32(s[12], _mm_setr_epi32(0, 1, 2, 3));
+    for (int i = 0; i < 16; ++i) x[i] = s[i];
+
+    for (int i = 0; i < 10; ++i) {
+        CHACHA_QR_SSE2(x[0], x[4], x[8], x[12]);
+        CHACHA_QR_SSE2(x[1], x[5], x[9], x[13]);
+        CHACHA_QR_SSE2(x[2], x[6], x[10], x[14]);
+        CHACHA_QR_SSE2(x[3], x[7], x[11], x[15]);
+        CHACHA_QR_SSE2(x[0], x[5], x[10], x[15]);
+        CHACHA_QR_SSE2(x[1], x[6], x[11], x[12]);
+        CHACHA_QR_SSE2(x[2], x[7], x[8], x[13]);
+        CHACHA_QR_SSE2(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; ++i) x[i] = _mm_add_epi32(x[i], s[i]);
+
+    for (int g = 0; g < 4; ++g) {
+        __m128i t0 = _mm_unpacklo_epi32(x[4*g + 0], x[4*g + 1]);
+        __m128i t1 = _mm_unpacklo_epi32(x[4*g + 2], x[4*g + 3]);
+        __m128i t2 = _mm_unpackhi_epi32(x[4*g + 0], x[4*g + 1]);
+        __m128i t3 = _mm_unpackhi_epi32(x[4*g + 2], x[4*g + 3]);
+        __m128i blk[4];
+        blk[0] = _mm_unpacklo_epi64(t0, t1);
+        blk[1] = _mm_unpackhi_epi64(t0, t1);
+        blk[2] = _mm_unpacklo_epi64(t2, t3);
+        blk[3] = _mm_unpackhi_epi64(t2, t3);
+        for (int b = 0; b < 4; ++b) {
+            size_t off = 64*(size_t)b + 16*(size_t)g;
+            if (in) blk[b] = _mm_xor_si128(blk[b], _mm_loadu_si128((const __m128i *)(in + off)));
+            _mm_storeu_si128((__m128i *)(out + off), blk[b]);
+        }
+    }
+}
+
+// Eight blocks, counters st[12] .. st[12] + 7
+__attribute__((target("avx2")))
+static inline void chacha20_xor_blocks8_avx2(uint8_t *out, const uint8_t *in, const uint32_t st[16]) {
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                         2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i r8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                        3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    __m256i x[16], s[16];
+    for (int i = 0; i < 16; ++i) s[i] = _mm256_set1_epi32((int)st[i]);
+    s[12] = _mm256_add_epi32(s[12], _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    for (int i = 0; i < 16; ++i) x[i] = s[i];
+
+    for (int i = 0; i < 10; ++i) {
+        CHACHA_QR_AVX2(x[0], x[4], x[8], x[12], r16, r8);
+        CHACHA_QR_AVX2(x[1], x[5], x[9], x[13], r16, r8);
+        CHACHA_QR_AVX2(x[2], x[6], x[10], x[14], r16, r8);
+        CHACHA_QR_AVX2(x[3], x[7], x[11], x[15], r16, r8);
+        CHACHA_QR_AVX2(x[0], x[5], x[10], x[15], r16, r8);
+        CHACHA_QR_AVX2(x[1], x[6], x[11], x[12], r16, r8);
+        CHACHA_QR_AVX2(x[2], x[7], x[8], x[13], r16, r8);
+        CHACHA_QR_AVX2(x[3], x[4], x[9], x[14], r16, r8);
+    }
+    for (int i = 0; i < 16; ++i) x[i] = _mm256_add_epi32(x[i], s[i]);
+
+    // In-lane 4x4 transpose leaves block b in the low half and block b+4 in
+    // the high half of blk[b]
+    for (int g = 0; g < 4; ++g) {
+        __m256i t0 = _mm256_unpacklo_epi32(x[4*g + 0], x[4*g + 1]);
+        __m256i t1 = _mm256_unpacklo_epi32(x[4*g + 2], x[4*g + 3]);
+        __m256i t2 = _mm256_unpackhi_epi32(x[4*g + 0], x[4*g + 1]);
+        __m256i t3 = _mm256_unpackhi_epi32(x[4*g + 2], x[4*g + 3]);
+        __m256i blk[4];
+        blk[0] = _mm256_unpacklo_epi64(t0, t1);
+        blk[1] = _mm256_unpackhi_epi64(t0, t1);
+        blk[2] = _mm256_unpacklo_epi64(t2, t3);
+        blk[3] = _mm256_unpackhi_epi64(t2, t3);
+        for (int b = 0; b < 4; ++b) {
+            __m128i lo128 = _mm256_castsi256_si128(blk[b]);
+            __m128i hi128 = _mm256_extracti128_si256(blk[b], 1);
+            size_t off_lo = 64*(size_t)b + 16*(size_t)g;
+            size_t off_hi = 64*(size_t)(b + 4) + 16*(size_t)g;
+            if (in) {
+                lo128 = _mm_xor_si128(lo128, _mm_loadu_si128((const __m128i *)(in + off_lo)));
+                hi128 = _mm_xor_si128(hi128, _mm_loadu_si128((const __m128i *)(in + off_hi)));
+            }
+            _mm_storeu_si128((__m128i *)(out + off_lo), lo128);
+            _mm_storeu_si128((__m128i *)(out + off_hi), hi128);
+        }
+    }
+}
+
+#endif // CHACHA20_SIMD_H
@@ -0,0 +1,173 @@
+// chacha_rng.h
+// arc4random-style userspace CSPRNG (header-only, Linux)
+//
+// - Per-thread ChaCha20 keystream buffer (RNG_BLOCKS * 64 bytes), refilled
+//   in one chacha20_keystream() batch (keystream.h).  No locks.
+// - Fast key erasure: every refill immediately rekeys from the first 44
+//   bytes of the new keystream and wipes them; bytes handed out are wiped
+//   from the buffer too, so a later state compromise cannot recover them.
+// - Seeded from getrandom(); new seed material is mixed in every
+//   RNG_RESEED_BYTES.  The state page is MADV_WIPEONFORK, so a forked
+//   child starts from a fresh seed instead of repeating the parent.
+//
+// Replaces rand()/srand(time(NULL)) for key generation and witness choice.
+
+#ifndef CHACHA_RNG_H
+#define CHACHA_RNG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include "keystream.h"
+
+#define RNG_BLOCKS        64          // 4 KB keystream buffer per thread
+#define RNG_KEYSZ         32
+#define RNG_NONCESZ       12
+#define RNG_SEEDSZ        (RNG_KEYSZ + RNG_NONCESZ)
+#define RNG_RESEED_BYTES  (1600000)   // mix in fresh getrandom() output this often
+
+#ifndef MADV_WIPEONFORK
+#define MADV_WIPEONFORK 18
+#endif
+
+typedef struct {
+    int initialized;                 // 0 on first use and in a forked child
+    uint32_t input[16];              // ChaCha20 state: constants, key, counter, nonce
+    size_t have;                     // unread bytes at the end of buf
+    size_t since_reseed;
+    uint8_t buf[RNG_BLOCKS * 64];
+} chacha_rng_t;
+
+static __thread chacha_rng_t *rng_tls;
+
+static inline uint32_t rng_load32(const uint8_t *p) {
+    return ((uint32_t)p[0]) | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Key and nonce from 44 bytes, block counter back to 0
+static inline void rng_setkey(chacha_rng_t *r, const uint8_t seed[RNG_SEEDSZ]) {
+    r->input[0] = 0x61707865; r->input[1] = 0x3320646e;
+    r->input[2] = 0x79622d32; r->input[3] = 0x6b206574;
+    for (int i = 0; i < 8; ++i) r->input[4 + i] = rng_load32(seed + 4*i);
+    r->input[12] = 0;
+    for (int i = 0; i < 3; ++i) r->input[13 + i] = rng_load32(seed + RNG_KEYSZ + 4*i);
+}
+
+// Entropy from the kernel; aborts rather than continuing unseeded
+static inline void rng_getentropy(uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = getrandom(buf, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+            if (fd < 0 || read(fd, buf, len) != (ssize_t)len) {
+                fprintf(stderr, "chacha_rng: no entropy source available\n");
+                abort();
+            }
+            close(fd);
+            return;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+// Generate a buffer of keystream and rekey from its first RNG_SEEDSZ bytes
+static inline void rng_refill(chacha_rng_t *r) {
+    chacha20_keystream(r->buf, r->input, RNG_BLOCKS);
+    rng_setkey(r, r->buf);
+    memset(r->buf, 0, RNG_SEEDSZ);
+    r->have = sizeof(r->buf) - RNG_SEEDSZ;
+}
+
+// Mix fresh kernel entropy into the key
+static inline void rng_stir(chacha_rng_t *r) {
+    uint8_t seed[RNG_SEEDSZ];
+    rng_getentropy(seed, sizeof(seed));
+    if (!r->initialized) {
+        rng_setkey(r, seed);
+        r->initialized = 1;
+    } else {
+        rng_refill(r);
+        for (size_t i = 0; i < RNG_SEEDSZ; ++i) r->buf[RNG_SEEDSZ + i] ^= seed[i];
+        rng_setkey(r, r->buf + RNG_SEEDSZ);
+    }
+    memset(seed, 0, sizeof(seed));
+    memset(r->buf, 0, sizeof(r->buf));
+    r->have = 0;
+    r->since_reseed = 0;
+}
+
+static inline chacha_rng_t *rng_state(void) {
+    chacha_rng_t *r = rng_tls;
+    if (!r) {
+        void *p = mmap(NULL, sizeof(chacha_rng_t), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            perror("chacha_rng: mmap");
+            abort();
+        }
+        madvise(p, sizeof(chacha_rng_t), MADV_WIPEONFORK);  // best effort on old kernels
+        r = rng_tls = (chacha_rng_t *)p;
+    }
+    if (!r->initialized || r->since_reseed >= RNG_RESEED_BYTES) rng_stir(r);
+    return r;
+}
+
+// Fill buf with n random bytes
+static inline void rng_bytes(void *buf, size_t n) {
+    chacha_rng_t *r = rng_state();
+    uint8_t *out = (uint8_t *)buf;
+
+    r->since_reseed += n;
+    if (n <= r->have) {
+        // Common case, no refill: constant n inlines to plain moves
+        uint8_t *src = r->buf + sizeof(r->buf) - r->have;
+        memcpy(out, src, n);
+        memset(src, 0, n);
+        r->have -= n;
+        return;
+    }
+    while (n > 0) {
+        if (r->have == 0) rng_refill(r);
+        size_t take = n < r->have ? n : r->have;
+        uint8_t *src = r->buf + sizeof(r->buf) - r->have;
+        memcpy(out, src, take);
+        memset(src, 0, take);
+        out += take;
+        n -= take;
+        r->have -= take;
+    }
+}
+
+static inline uint32_t rng_u32(void) {
+    uint32_t v;
+    rng_bytes(&v, sizeof(v));
+    return v;
+}
+
+static inline uint64_t rng_u64(void) {
+    uint64_t v;
+    rng_bytes(&v, sizeof(v));
+    return v;
+}
+
+// Uniform in [0, bound) without modulo bias; bound == 0 returns 0
+static inline uint64_t rng_uniform(uint64_t bound) {
+    if (bound < 2) return 0;
+    uint64_t min = (0 - bound) % bound;  // 2^64 mod bound
+    uint64_t v;
+    do {
+        v = rng_u64();
+    } while (v < min);
+    return v % bound;
+}
+
+#endif // CHACHA_RNG_H
@@ -1,9 +1,14 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <x86intrin.h>  // For __rdtsc()
+#include "keystream.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_hist.h"
+#include "bench_perf.h"
 
 // ChaCha20 parameters
 #define CHACHA_ROUNDS 20  // 20 = 10 double-rounds
@@ -77,7 +82,8 @@ void chacha20_init(chacha20_state_t *st, const uint8_t key[32], const uint8_t no
     st->input[15] = u8to32(nonce + 8);
 }
 
-void chacha20_encrypt_buffer(chacha20_state_t *st, uint8_t *data, size_t len) {
+// Scalar reference path, one block at a time
+void chacha20_encrypt_buffer_scalar(chacha20_state_t *st, uint8_t *data, size_t len) {
     uint8_t keystream[64];
     size_t pos = 0;
     while (pos < len) {
@@ -92,6 +98,19 @@ void chacha20_encrypt_buffer(chacha20_state_t *st, uint8_t *data, size_t len) {
     }
 }
 
+// Keystream is generated KEYSTREAM_BATCH bytes at a time by the SIMD
+// kernels, then XORed 64 bytes per iteration
+void chacha20_encrypt_buffer(chacha20_state_t *st, uint8_t *data, size_t len) {
+    uint8_t keystream[KEYSTREAM_BATCH] __attribute__((aligned(KEYSTREAM_ALIGN)));
+    size_t pos = 0;
+    while (pos < len) {
+        size_t take = (len - pos > sizeof(keystream)) ? sizeof(keystream) : (len - pos);
+        chacha20_keystream(keystream, st->input, (take + 63) / 64);
+        keystream_xor(data + pos, data + pos, keystream, take);
+        pos += take;
+    }
+}
+
 // Simple LCG for pseudo-random data (same as your AES example)
 static uint32_t lcg_seed = 123456789;
 uint32_t lcg_rand() {
@@ -102,7 +121,36 @@ void generate_random(uint8_t *buf, size_t len) {
     for (size_t i = 0; i < len; ++i) buf[i] = (uint8_t)(lcg_rand() & 0xffu);
 }
 
+// The batched path must match the scalar one, including partial blocks
+static int chacha20_self_check(void) {
+    static const size_t lens[] = { 1, 63, 64, 65, 255, 256, 511, 512, 1000, 1025, 4099 };
+    uint8_t key[32], nonce[12], ref[4099], buf[4099];
+    chacha20_state_t a, b;
+
+    generate_random(key, sizeof(key));
+    generate_random(nonce, sizeof(nonce));
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i) {
+        generate_random(ref, lens[i]);
+        memcpy(buf, ref, lens[i]);
+        chacha20_init(&a, key, nonce, 7u);
+        chacha20_init(&b, key, nonce, 7u);
+        chacha20_encrypt_buffer_scalar(&a, ref, lens[i]);
+        chacha20_encrypt_buffer(&b, buf, lens[i]);
+        if (memcmp(ref, buf, lens[i]) != 0 || a.input[12] != b.input[12]) {
+            printf("Self-check FAILED at length %zu\n", lens[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
 int main() {
+    bench_isolate(0);
+    bench_timing_init();
+
+    bench_perf_t perf;
+    bench_perf_open(&perf);
+
     chacha20_state_t state;
     size_t data_len = 1024 * 1024; // 1 MB
     uint8_t *data = malloc(data_len);
@@ -113,9 +161,17 @@ int main() {
         perror("Failed to allocate memory");
         return 1;
     }
+    bench_prefault(data, data_len);
+
+    if (!chacha20_self_check()) {
+        free(data);
+        return 1;
+    }
 
     const int runs = 10000;  // match AES example's run count
     uint64_t total_cycles = 0;
+    bench_hist_t hist;
+    bench_hist_init(&hist);
 
     for (int i = 0; i < runs; ++i) {
         generate_random(data, data_len);       // random plaintext
@@ -125,11 +181,15 @@ int main() {
         // Initialize state with counter = 0
         chacha20_init(&state, key, nonce, 0u);
 
-        uint64_t start = __rdtsc();
+        bench_perf_start(&perf);
+        uint64_t start = bench_tsc_start();
         chacha20_encrypt_buffer(&state, data, data_len);
-        uint64_t end = __rdtsc();
+        uint64_t end = bench_tsc_stop();
+        bench_perf_stop(&perf);
 
-        total_cycles += (end - start);
+        uint64_t cycles = bench_elapsed(start, end);
+        total_cycles += cycles;
+        bench_hist_record(&hist, cycles);
     }
 
     double avg_cycles = (double)total_cycles / runs;
@@ -144,6 +204,9 @@ int main() {
     printf("Total runs: %d\n", runs);
     printf("Average cycles (ChaCha20 only): %.2f\n", avg_cycles);
     printf("Average cycles per byte: %.2f\n", avg_cycles / data_len);
+    printf("Average ns per byte: %.3f (TSC %.3f GHz)\n", bench_ns(avg_cycles) / data_len, bench_tsc_ghz);
+    bench_hist_print(&hist, "Cycles per byte", (double)data_len);
+    bench_perf_print(&perf, "Counters per byte", (double)data_len * runs);
 
     free(data);
     return 0;
@@ -1,9 +1,12 @@
+#define _GNU_SOURCE
 #include <gmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <time.h>
-#include <x86intrin.h>  // for __rdtsc()
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_hist.h"
 
 #define RUNS 10000
 #define PRIME_BITS 512
@@ -129,6 +132,9 @@ int solovay_strassen_test(const mpz_t n, gmp_randstate_t state) {
 // Benchmark
 //------------------------------------------------------------
 int main() {
+    bench_isolate(0);
+    bench_timing_init();
+
     gmp_randstate_t state;
     gmp_randinit_mt(state);
     gmp_randseed_ui(state, time(NULL));
@@ -137,6 +143,10 @@ int main() {
     mpz_init(n);
 
     unsigned long long total_mr = 0, total_ss = 0, total_gmp = 0;
+    bench_hist_t hist_mr, hist_ss, hist_gmp;
+    bench_hist_init(&hist_mr);
+    bench_hist_init(&hist_ss);
+    bench_hist_init(&hist_gmp);
 
     for (int i = 0; i < RUNS; i++) {
         mpz_urandomb(n, state, PRIME_BITS);
@@ -146,29 +156,36 @@ int main() {
         unsigned long long start, end;
 
         // Miller-Rabin
-        start = __rdtsc();
+        start = bench_tsc_start();
         miller_rabin_test(n, state);
-        end = __rdtsc();
-        total_mr += (end - start);
+        end = bench_tsc_stop();
+        total_mr += bench_elapsed(start, end);
+        bench_hist_record(&hist_mr, bench_elapsed(start, end));
 
         // Solovay–Strassen
-        start = __rdtsc();
+        start = bench_tsc_start();
         solovay_strassen_test(n, state);
-        end = __rdtsc();
-        total_ss += (end - start);
+        end = bench_tsc_stop();
+        total_ss += bench_elapsed(start, end);
+        bench_hist_record(&hist_ss, bench_elapsed(start, end));
 
         // GMP built-in
-        start = __rdtsc();
+        start = bench_tsc_start();
         mpz_probab_prime_p(n, ITERATIONS);
-        end = __rdtsc();
-        total_gmp += (end - start);
+        end = bench_tsc_stop();
+        total_gmp += bench_elapsed(start, end);
+        bench_hist_record(&hist_gmp, bench_elapsed(start, end));
     }
 
     printf("Average cycles over %d runs (random %d-bit numbers, %d iterations):\n", 
             RUNS, PRIME_BITS, ITERATIONS);
-    printf(" Miller-Rabin     : %llu cycles\n", total_mr / RUNS);
-    printf(" Solovay-Strassen : %llu cycles\n", total_ss / RUNS);
-    printf(" GMP library      : %llu cycles\n", total_gmp / RUNS);
+    printf(" Miller-Rabin     : %llu cycles (%.1f us)\n", total_mr / RUNS, bench_ns((double)(total_mr / RUNS)) / 1e3);
+    printf(" Solovay-Strassen : %llu cycles (%.1f us)\n", total_ss / RUNS, bench_ns((double)(total_ss / RUNS)) / 1e3);
+    printf(" GMP library      : %llu cycles (%.1f us)\n", total_gmp / RUNS, bench_ns((double)(total_gmp / RUNS)) / 1e3);
+    printf("Cycle distribution:\n");
+    bench_hist_print(&hist_mr,  " Miller-Rabin    ", 1.0);
+    bench_hist_print(&hist_ss,  " Solovay-Strassen", 1.0);
+    bench_hist_print(&hist_gmp, " GMP library     ", 1.0);
 
     mpz_clear(n);
     gmp_randclear(state);
@@ -0,0 +1,105 @@
+// keystream.h
+// Bulk keystream generation and wide XOR for the stream ciphers (header-only)
+//
+// chacha20_keystream() / salsa20_keystream() write any number of whole
+// 64-byte blocks into a caller buffer with the widest available kernel and
+// advance the block counter.  keystream_xor() then combines keystream with
+// data 64 bytes per iteration (two AVX2 or four SSE2 registers), so the
+// byte-wise "data[pos + j] ^= keystream[j]" loop is gone from the ciphers.
+// One-time-pad tools and generators can call the *_keystream functions
+// directly and skip the XOR.
+
+#ifndef KEYSTREAM_H
+#define KEYSTREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <immintrin.h>
+#include "chacha20_simd.h"
+#include "salsa20_simd.h"
+
+#define KEYSTREAM_ALIGN   64
+#define KEYSTREAM_BATCH   1024   // bytes per batch for callers using a stack buffer
+
+static inline void keystream_xor_sse2(uint8_t *out, const uint8_t *in, const uint8_t *ks, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(in + i + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i *)(in + i + 32));
+        __m128i a3 = _mm_loadu_si128((const __m128i *)(in + i + 48));
+        a0 = _mm_xor_si128(a0, _mm_loadu_si128((const __m128i *)(ks + i)));
+        a1 = _mm_xor_si128(a1, _mm_loadu_si128((const __m128i *)(ks + i + 16)));
+        a2 = _mm_xor_si128(a2, _mm_loadu_si128((const __m128i *)(ks + i + 32)));
+        a3 = _mm_xor_si128(a3, _mm_loadu_si128((const __m128i *)(ks + i + 48)));
+        _mm_storeu_si128((__m128i *)(out + i), a0);
+        _mm_storeu_si128((__m128i *)(out + i + 16), a1);
+        _mm_storeu_si128((__m128i *)(out + i + 32), a2);
+        _mm_storeu_si128((__m128i *)(out + i + 48), a3);
+    }
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *)(ks + i)));
+        _mm_storeu_si128((__m128i *)(out + i), a);
+    }
+    for (; i < len; ++i) out[i] = in[i] ^ ks[i];
+}
+
+__attribute__((target("avx2")))
+static inline void keystream_xor_avx2(uint8_t *out, const uint8_t *in, const uint8_t *ks, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(in + i + 32));
+        a0 = _mm256_xor_si256(a0, _mm256_loadu_si256((const __m256i *)(ks + i)));
+        a1 = _mm256_xor_si256(a1, _mm256_loadu_si256((const __m256i *)(ks + i + 32)));
+        _mm256_storeu_si256((__m256i *)(out + i), a0);
+        _mm256_storeu_si256((__m256i *)(out + i + 32), a1);
+    }
+    keystream_xor_sse2(out + i, in + i, ks + i, len - i);
+}
+
+// out = in ^ ks; out may alias in
+static inline void keystream_xor(uint8_t *out, const uint8_t *in, const uint8_t *ks, size_t len) {
+    if (len >= 64 && chacha20_have_avx2()) keystream_xor_avx2(out, in, ks, len);
+    else keystream_xor_sse2(out, in, ks, len);
+}
+
+// nblocks ChaCha20 blocks (RFC 8439 layout) into out; advances st[12]
+static inline void chacha20_keystream(uint8_t *out, uint32_t st[16], size_t nblocks) {
+    size_t b = 0;
+    if (chacha20_have_avx2()) {
+        for (; nblocks - b >= 8; b += 8, st[12] += 8)
+            chacha20_xor_blocks8_avx2(out + 64*b, NULL, st);
+    }
+    for (; nblocks - b >= 4; b += 4, st[12] += 4)
+        chacha20_xor_blocks4_sse2(out + 64*b, NULL, st);
+    if (b < nblocks) {
+        uint8_t tmp[256];
+        chacha20_xor_blocks4_sse2(tmp, NULL, st);
+        memcpy(out + 64*b, tmp, 64*(nblocks - b));
+        st[12] += (uint32_t)(nblocks - b);
+    }
+}
+
+// nblocks Salsa20/rounds blocks (standard layout) into out; advances st[8..9]
+static inline void salsa20_keystream(uint8_t *out, uint32_t st[16], size_t nblocks, int rounds) {
+    size_t b = 0;
+    if (salsa20_have_avx2()) {
+        for (; nblocks - b >= 8; b += 8) {
+            salsa20_xor_blocks8_avx2(out + 64*b, NULL, st, rounds);
+            salsa20_counter_add(st, 8);
+        }
+    }
+    for (; nblocks - b >= 4; b += 4) {
+        salsa20_xor_blocks4_sse2(out + 64*b, NULL, st, rounds);
+        salsa20_counter_add(st, 4);
+    }
+    for (; b < nblocks; ++b) {
+        salsa20_xor_block_sse2(out + 64*b, NULL, st, rounds);
+        salsa20_counter_add(st, 1);
+    }
+}
+
+#endif // KEYSTREAM_H
@@ -0,0 +1,250 @@
+// mont64.h
+// Modular arithmetic on 64-bit words for the small-RSA programs
+// (header-only)
+//
+// - Montgomery multiplication modulo odd n < 2^64, R = 2^64, on one
+//   unsigned __int128 product per step; no 128-bit division after init.
+// - mont128_*: the same for odd n < 2^128 held in two words (R = 2^128),
+//   for RSA moduli p q above 2^64; modinv128() and gcd128() for the key,
+//   u128_format()/u128_parse() for printing and reading such numbers.
+// - modexp64(): base^exp mod any modulus below 2^64, without the
+//   overflow of a 64-bit (a * b) % n once n exceeds 2^32.
+// - is_prime64(): deterministic Miller-Rabin for every n < 2^64 with the
+//   7-base set {2, 325, 9375, 28178, 450775, 9780504, 1795265022}
+//   (Jim Sinclair); no random witnesses, no error probability.
+
+#ifndef MONT64_H
+#define MONT64_H
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+    uint64_t n;      // odd modulus
+    uint64_t ninv;   // n^-1 mod 2^64
+    uint64_t one;    // R mod n, i.e. 1 in Montgomery form
+    uint64_t r2;     // R^2 mod n, for conversion into Montgomery form
+} mont64_t;
+
+static inline void mont64_init(mont64_t *m, uint64_t n) {
+    uint64_t inv = n;                    // correct to 3 bits for odd n
+    for (int i = 0; i < 5; i++) inv *= 2 - n * inv;
+    m->n = n;
+    m->ninv = inv;
+    m->one = ((uint64_t)0 - n) % n;
+    m->r2 = (uint64_t)((unsigned __int128)m->one * m->one % n);
+}
+
+// t R^-1 mod n for t < n R: subtracting q n, q = t n^-1 mod R, clears the
+// low word, so the result is hi(t) - hi(q n), plus n if that borrows.
+// Unlike t + q n this cannot overflow 128 bits for n close to 2^64.
+static inline uint64_t mont64_reduce(const mont64_t *m, unsigned __int128 t) {
+    uint64_t q = (uint64_t)t * m->ninv;
+    uint64_t h = (uint64_t)(((unsigned __int128)q * m->n) >> 64);
+    uint64_t th = (uint64_t)(t >> 64);
+    return th >= h ? th - h : th - h + m->n;
+}
+
+static inline uint64_t mont64_mul(const mont64_t *m, uint64_t a, uint64_t b) {
+    return mont64_reduce(m, (unsigned __int128)a * b);
+}
+
+static inline uint64_t mont64_to(const mont64_t *m, uint64_t a) {
+    return mont64_mul(m, a % m->n, m->r2);
+}
+
+static inline uint64_t mont64_from(const mont64_t *m, uint64_t a) {
+    return mont64_reduce(m, a);
+}
+
+// x^e with x and the result in Montgomery form
+static inline uint64_t mont64_pow(const mont64_t *m, uint64_t x, uint64_t e) {
+    uint64_t r = m->one;
+    while (e) {
+        if (e & 1) r = mont64_mul(m, r, x);
+        x = mont64_mul(m, x, x);
+        e >>= 1;
+    }
+    return r;
+}
+
+// base^exp mod mod; Montgomery for odd moduli, 128-bit remainders otherwise
+static inline uint64_t modexp64(uint64_t base, uint64_t exp, uint64_t mod) {
+    if (mod == 1) return 0;
+    if (mod & 1) {
+        mont64_t m;
+        mont64_init(&m, mod);
+        return mont64_from(&m, mont64_pow(&m, mont64_to(&m, base), exp));
+    }
+    uint64_t r = 1;
+    base %= mod;
+    while (exp) {
+        if (exp & 1) r = (uint64_t)((unsigned __int128)r * base % mod);
+        base = (uint64_t)((unsigned __int128)base * base % mod);
+        exp >>= 1;
+    }
+    return r;
+}
+
+// Deterministic Miller-Rabin for all n < 2^64; trial division by the
+// primes up to 37 first, which settles n < 37^2 and most composites
+static inline int is_prime64(uint64_t n) {
+    static const uint8_t small[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    static const uint64_t bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+
+    if (n < 2) return 0;
+    for (unsigned i = 0; i < sizeof(small); i++)
+        if (n % small[i] == 0) return n == small[i];
+    if (n < 37 * 37) return 1;
+
+    // n - 1 = d 2^s
+    uint64_t d = n - 1;
+    int s = __builtin_ctzll(d);
+    d >>= s;
+
+    mont64_t m;
+    mont64_init(&m, n);
+    uint64_t minus1 = n - m.one;         // -1 in Montgomery form
+
+    for (unsigned i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        uint64_t a = bases[i] % n;
+        if (a == 0) continue;            // n divides the base: says nothing
+        uint64_t x = mont64_pow(&m, mont64_to(&m, a), d);
+        if (x == m.one || x == minus1) continue;
+        int r = 1;
+        for (; r < s; r++) {
+            x = mont64_mul(&m, x, x);
+            if (x == minus1) break;
+        }
+        if (r == s) return 0;
+    }
+    return 1;
+}
+
+// --- Two-word moduli ---
+
+typedef unsigned __int128 u128;
+
+typedef struct {
+    uint64_t n0, n1;  // odd modulus, low and high word
+    uint64_t ninv;    // -n^-1 mod 2^64
+    u128 one;         // R mod n, R = 2^128
+    u128 r2;          // R^2 mod n
+} mont128_t;
+
+// a b R^-1 mod n, CIOS over two words, for a b < n R (a, b < n, or one of
+// them below n and the other anything).  Only 64 x 64 -> 128-bit products,
+// no division.
+static inline u128 mont128_mul(const mont128_t *m, u128 a, u128 b) {
+    uint64_t a0 = (uint64_t)a, a1 = (uint64_t)(a >> 64);
+    uint64_t t0 = 0, t1 = 0, t2 = 0;
+
+    for (int i = 0; i < 2; i++) {
+        uint64_t bi = i ? (uint64_t)(b >> 64) : (uint64_t)b;
+        u128 c = (u128)a0 * bi + t0;
+        t0 = (uint64_t)c;
+        c = (c >> 64) + (u128)a1 * bi + t1;
+        t1 = (uint64_t)c;
+        c = (c >> 64) + t2;
+        t2 = (uint64_t)c;
+        uint64_t t3 = (uint64_t)(c >> 64);
+
+        // t = (t + q n) / 2^64 with q chosen so the low word cancels
+        uint64_t q = t0 * m->ninv;
+        c = ((u128)q * m->n0 + t0) >> 64;
+        c += (u128)q * m->n1 + t1;
+        t0 = (uint64_t)c;
+        c = (c >> 64) + t2;
+        t1 = (uint64_t)c;
+        t2 = t3 + (uint64_t)(c >> 64);
+    }
+
+    u128 r = ((u128)t1 << 64) | t0, n = ((u128)m->n1 << 64) | m->n0;
+    return (t2 || r >= n) ? r - n : r;
+}
+
+static inline void mont128_init(mont128_t *m, u128 n) {
+    uint64_t inv = (uint64_t)n;
+    for (int i = 0; i < 5; i++) inv *= 2 - (uint64_t)n * inv;
+    m->n0 = (uint64_t)n;
+    m->n1 = (uint64_t)(n >> 64);
+    m->ninv = (uint64_t)0 - inv;
+    m->one = ((u128)0 - n) % n;
+
+    // R^2: 2R mod n is 2 in Montgomery form; seven squarings give 2^128
+    u128 x = m->one;
+    x = (x >> 127 || (x << 1) >= n) ? (x << 1) - n : x << 1;
+    for (int i = 0; i < 7; i++) x = mont128_mul(m, x, x);
+    m->r2 = x;
+}
+
+// x^e with x and the result in Montgomery form
+static inline u128 mont128_pow(const mont128_t *m, u128 x, u128 e) {
+    u128 r = m->one;
+    while (e) {
+        if (e & 1) r = mont128_mul(m, r, x);
+        x = mont128_mul(m, x, x);
+        e >>= 1;
+    }
+    return r;
+}
+
+// base^exp mod n for a context built once per modulus, any base < 2^128
+static inline u128 mont128_modexp(const mont128_t *m, u128 base, u128 exp) {
+    u128 x = mont128_pow(m, mont128_mul(m, base, m->r2), exp);
+    return mont128_mul(m, x, 1);
+}
+
+static inline u128 gcd128(u128 a, u128 b) {
+    while (b) {
+        u128 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// a^-1 mod m, 0 if gcd(a, m) != 1; m < 2^127.  Extended Euclid on
+// unsigned remainders; the signed coefficients never exceed m in size.
+static inline u128 modinv128(u128 a, u128 m) {
+    u128 r0 = m, r1 = a % m;
+    __int128 x0 = 0, x1 = 1;
+    while (r1) {
+        u128 q = r0 / r1, r = r0 - q * r1;
+        __int128 x = x0 - (__int128)q * x1;
+        r0 = r1;
+        r1 = r;
+        x0 = x1;
+        x1 = x;
+    }
+    if (r0 != 1) return 0;
+    return x0 < 0 ? (u128)(x0 + (__int128)m) : (u128)x0;
+}
+
+// Decimal text of x in buf (at least 40 bytes); returns buf
+static inline char *u128_format(char *buf, u128 x) {
+    char tmp[40];
+    int len = 0;
+    do {
+        tmp[len++] = (char)('0' + (int)(x % 10));
+        x /= 10;
+    } while (x);
+    for (int i = 0; i < len; i++) buf[i] = tmp[len - 1 - i];
+    buf[len] = '\0';
+    return buf;
+}
+
+// Decimal digits to x; returns 0 on an empty, non-numeric or too long string
+static inline int u128_parse(const char *s, u128 *x) {
+    u128 v = 0;
+    if (!*s) return 0;
+    for (; *s; s++) {
+        if (*s < '0' || *s > '9') return 0;
+        if (v > (((u128)0 - 1) - (u128)(*s - '0')) / 10) return 0;
+        v = v * 10 + (u128)(*s - '0');
+    }
+    *x = v;
+    return 1;
+}
+
+#endif // MONT64_H
@@ -1,96 +1,14 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <windows.h>   // Windows API for affinity & priorities
-#include <x86intrin.h> // __rdtsc
-
-// Macro for one PRGA step
-#define RC4_STEP(i, j, S, data, idx) do { \
-    i += 1; \
-    j += S[i]; \
-    tmp = S[i]; S[i] = S[j]; S[j] = tmp; \
-    data[idx++] ^= S[(uint8_t)(S[i] + S[j])]; \
-} while (0)
-
-typedef struct {
-    uint8_t S[256];
-    uint8_t i;
-    uint8_t j;
-} rc4_state_t;
-
-void rc4_init(rc4_state_t *state, const uint8_t *key, size_t keylen) {
-    uint8_t j = 0, tmp;
-    for (uint16_t i = 0; i < 256; ++i) {
-        state->S[i] = (uint8_t)i;
-    }
-    for (uint16_t i = 0; i < 256; ++i) {
-        j += state->S[i] + key[i % keylen];
-        tmp = state->S[i];
-        state->S[i] = state->S[j];
-        state->S[j] = tmp;
-    }
-    state->i = 0;
-    state->j = 0;
-}
-
-void rc4_crypt(rc4_state_t *state, uint8_t *data, size_t len) {
-    uint8_t i = state->i;
-    uint8_t j = state->j;
-    uint8_t tmp;
-    size_t idx = 0;
-
-    // Unrolled loop (16x) for maximum performance
-    size_t blocks = len / 16;
-    for (size_t b = 0; b < blocks; ++b) {
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
-    }
-
-    // Handle remaining bytes (0-15)
-    size_t remain = len % 16;
-    for (size_t r = 0; r < remain; ++r) {
-        RC4_STEP(i, j, state->S, data, idx);
-    }
-
-    state->i = i;
-    state->j = j;
-}
-
-// Windows version of setup_no_interruptions
-void setup_no_interruptions() {
-    SYSTEM_INFO sysInfo;
-    GetSystemInfo(&sysInfo);
-    DWORD numCores = sysInfo.dwNumberOfProcessors;
-
-    if (numCores < 2) {
-        fprintf(stderr, "System has only 1 core; cannot assign a separate core.\n");
-        exit(1);
-    }
-
-    // Pin thread to last CPU core
-    HANDLE hThread = GetCurrentThread();
-    DWORD_PTR mask = (DWORD_PTR)1 << (numCores - 1);
-    if (SetThreadAffinityMask(hThread, mask) == 0) {
-        perror("Failed to set CPU affinity");
-        exit(1);
-    }
-
-    // Set highest priority possible
-    if (!SetThreadPriority(hThread, THREAD_PRIORITY_TIME_CRITICAL)) {
-        perror("Failed to set thread priority");
-        exit(1);
-    }
-
-    // No direct mlockall equivalent in Windows; VirtualLock can lock memory region if needed
-}
+#include "rc4.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_hist.h"
+#include "bench_perf.h"
 
 // Simple LCG for generating unique keys and plaintexts
 static uint32_t lcg_seed = 123456789;
@@ -106,7 +24,11 @@ void generate_random(uint8_t *buf, size_t len) {
 }
 
 int main() {
-    setup_no_interruptions();
+    bench_isolate(0);
+    bench_timing_init();
+
+    bench_perf_t perf;
+    bench_perf_open(&perf);
 
     rc4_state_t state;
     size_t data_len = 1024 * 1024;  // 1 MB
@@ -116,9 +38,12 @@ int main() {
         perror("Failed to allocate memory");
         exit(1);
     }
+    bench_prefault(data, data_len);
 
     const int runs = 10000;
     uint64_t total_cycles = 0;
+    bench_hist_t hist;
+    bench_hist_init(&hist);
 
     // Warm-up run to cache data/instructions
     generate_random(data, data_len);
@@ -131,10 +56,14 @@ int main() {
         generate_random(key, sizeof(key));
         rc4_init(&state, key, sizeof(key));
 
-        uint64_t start = __rdtsc();
+        bench_perf_start(&perf);
+        uint64_t start = bench_tsc_start();
         rc4_crypt(&state, data, data_len);
-        uint64_t end = __rdtsc();
-        total_cycles += (end - start);
+        uint64_t end = bench_tsc_stop();
+        bench_perf_stop(&perf);
+        uint64_t cycles = bench_elapsed(start, end);
+        total_cycles += cycles;
+        bench_hist_record(&hist, cycles);
 
         if ((i + 1) % 100000 == 0) {
             printf("Completed %d runs\n", i + 1);
@@ -154,6 +83,9 @@ int main() {
     printf("Total runs: %d\n", runs);
     printf("Average cycles (rdtsc, PRGA burst only): %.2f\n", avg_cycles);
     printf("Average cycles per byte: %.2f\n", avg_cycles / data_len);
+    printf("Average ns per byte: %.3f (TSC %.3f GHz)\n", bench_ns(avg_cycles) / data_len, bench_tsc_ghz);
+    bench_hist_print(&hist, "Cycles per byte", (double)data_len);
+    bench_perf_print(&perf, "Counters per byte", (double)data_len * runs);
 
     free(data);
     return 0;
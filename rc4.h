@@ -0,0 +1,244 @@
+// rc4.h
+// RC4 core shared by the RC4 programs (header-only)
+//
+// rc4_crypt() is the 16x-unrolled single-stream PRGA.  Each step depends on
+// the previous j and on the bytes just swapped in S, so one stream runs at
+// load/store latency.  rc4_crypt_multi() steps 2, 4 or 8 independent
+// states in one loop; their dependency chains are unrelated, so the
+// out-of-order core overlaps them and aggregate throughput rises until
+// registers or loads/stores per cycle become the limit.
+
+#ifndef RC4_H
+#define RC4_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <emmintrin.h>
+
+#define RC4_MAX_STREAMS 8
+#define RC4_BATCH       16   // keys per batched key schedule
+
+// Macro for one PRGA step
+#define RC4_STEP(i, j, S, data, idx) do { \
+    i += 1; \
+    j += S[i]; \
+    tmp = S[i]; S[i] = S[j]; S[j] = tmp; \
+    data[idx++] ^= S[(uint8_t)(S[i] + S[j])]; \
+} while (0)
+
+typedef struct {
+    uint8_t S[256];
+    uint8_t i;
+    uint8_t j;
+} rc4_state_t;
+
+static inline void rc4_init(rc4_state_t *state, const uint8_t *key, size_t keylen) {
+    uint8_t j = 0, tmp;
+    for (uint16_t i = 0; i < 256; ++i) {
+        state->S[i] = (uint8_t)i;
+    }
+    for (uint16_t i = 0; i < 256; ++i) {
+        j += state->S[i] + key[i % keylen];
+        tmp = state->S[i];
+        state->S[i] = state->S[j];
+        state->S[j] = tmp;
+    }
+    state->i = 0;
+    state->j = 0;
+}
+
+static inline void rc4_crypt(rc4_state_t *state, uint8_t *data, size_t len) {
+    uint8_t i = state->i;
+    uint8_t j = state->j;
+    uint8_t tmp;
+    size_t idx = 0;
+
+    // Unrolled loop (16x) for speed
+    size_t blocks = len / 16;
+    for (size_t b = 0; b < blocks; ++b) {
+        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
+        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
+        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
+        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
+        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
+        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
+        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
+        RC4_STEP(i, j, state->S, data, idx); RC4_STEP(i, j, state->S, data, idx);
+    }
+
+    // Remaining bytes
+    size_t remain = len % 16;
+    for (size_t r = 0; r < remain; ++r) {
+        RC4_STEP(i, j, state->S, data, idx);
+    }
+
+    state->i = i;
+    state->j = j;
+}
+
+// Per-lane locals for the interleaved loops.  Every lane gets its own named
+// registers (S, data, i, j) so no lane's chain waits on another's; S[i] and
+// S[j] are loaded once and reused for the output index, since after the
+// swap S[i] + S[j] == a + b.
+#define RC4_LANE_LOAD(k) \
+    uint8_t *S##k = st[k]->S, *d##k = data[k]; \
+    uint8_t i##k = st[k]->i, j##k = st[k]->j
+
+#define RC4_LANE_STEP(k) do { \
+    uint8_t a = S##k[++i##k]; \
+    j##k += a; \
+    uint8_t b = S##k[j##k]; \
+    S##k[i##k] = b; S##k[j##k] = a; \
+    d##k[idx] ^= S##k[(uint8_t)(a + b)]; \
+} while (0)
+
+#define RC4_LANE_SAVE(k) do { st[k]->i = i##k; st[k]->j = j##k; } while (0)
+
+// 2, 4 or 8 streams over the same len bytes
+static inline void rc4_crypt_x2(rc4_state_t *const st[], uint8_t *const data[], size_t len) {
+    RC4_LANE_LOAD(0); RC4_LANE_LOAD(1);
+    for (size_t idx = 0; idx < len; ++idx) {
+        RC4_LANE_STEP(0); RC4_LANE_STEP(1);
+    }
+    RC4_LANE_SAVE(0); RC4_LANE_SAVE(1);
+}
+
+static inline void rc4_crypt_x4(rc4_state_t *const st[], uint8_t *const data[], size_t len) {
+    RC4_LANE_LOAD(0); RC4_LANE_LOAD(1); RC4_LANE_LOAD(2); RC4_LANE_LOAD(3);
+    for (size_t idx = 0; idx < len; ++idx) {
+        RC4_LANE_STEP(0); RC4_LANE_STEP(1); RC4_LANE_STEP(2); RC4_LANE_STEP(3);
+    }
+    RC4_LANE_SAVE(0); RC4_LANE_SAVE(1); RC4_LANE_SAVE(2); RC4_LANE_SAVE(3);
+}
+
+// 32 live values: some lane pointers spill on x86-64, so this is usually
+// no faster than x4; kept for cores with more load/store bandwidth
+static inline void rc4_crypt_x8(rc4_state_t *const st[], uint8_t *const data[], size_t len) {
+    RC4_LANE_LOAD(0); RC4_LANE_LOAD(1); RC4_LANE_LOAD(2); RC4_LANE_LOAD(3);
+    RC4_LANE_LOAD(4); RC4_LANE_LOAD(5); RC4_LANE_LOAD(6); RC4_LANE_LOAD(7);
+    for (size_t idx = 0; idx < len; ++idx) {
+        RC4_LANE_STEP(0); RC4_LANE_STEP(1); RC4_LANE_STEP(2); RC4_LANE_STEP(3);
+        RC4_LANE_STEP(4); RC4_LANE_STEP(5); RC4_LANE_STEP(6); RC4_LANE_STEP(7);
+    }
+    RC4_LANE_SAVE(0); RC4_LANE_SAVE(1); RC4_LANE_SAVE(2); RC4_LANE_SAVE(3);
+    RC4_LANE_SAVE(4); RC4_LANE_SAVE(5); RC4_LANE_SAVE(6); RC4_LANE_SAVE(7);
+}
+
+// Encrypt n independent sessions in place: data[k] (lens[k] bytes) with
+// state st[k].  Sessions are taken in groups of up to `width` (2, 4 or 8)
+// and stepped together over their common length; whatever one session has
+// beyond that is finished by rc4_crypt.  Equivalent to calling
+// rc4_crypt(st[k], data[k], lens[k]) for every k.
+static inline void rc4_crypt_multi(rc4_state_t *const st[], uint8_t *const data[],
+                                   const size_t lens[], size_t n, int width) {
+    size_t k = 0;
+    if (width > RC4_MAX_STREAMS) width = RC4_MAX_STREAMS;
+
+    while (k < n) {
+        size_t g = n - k;
+        if (g > (size_t)width) g = (size_t)width;
+        if (g >= 8) g = 8; else if (g >= 4) g = 4; else if (g >= 2) g = 2;
+
+        size_t common = lens[k];
+        for (size_t m = 1; m < g; ++m)
+            if (lens[k + m] < common) common = lens[k + m];
+
+        switch (g) {
+        case 8: rc4_crypt_x8(st + k, data + k, common); break;
+        case 4: rc4_crypt_x4(st + k, data + k, common); break;
+        case 2: rc4_crypt_x2(st + k, data + k, common); break;
+        default: common = 0; break;
+        }
+        for (size_t m = 0; m < g; ++m)
+            rc4_crypt(st[k + m], data[k + m] + common, lens[k + m] - common);
+        k += g;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Batched key schedule: RC4_BATCH keys at once
+//
+// The S-boxes are interleaved, S[x][k] = S_k[x], so the row every lane
+// touches at step i (S_k[i] for all k) is one 16-byte vector and only the
+// S_k[j_k] accesses are per-lane gathers/scatters.  The 16 lanes' swap
+// chains are independent and overlap in the out-of-order core.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t S[256][RC4_BATCH] __attribute__((aligned(16)));
+    uint8_t i, j[RC4_BATCH];    // i is shared: every lane starts at 0
+} rc4_batch_t;
+
+// Key-schedule n (<= RC4_BATCH) keys of the same length; unused lanes
+// repeat key 0
+static inline void rc4_init_batch(rc4_batch_t *b, const uint8_t *const keys[], size_t keylen, int n) {
+    uint8_t K[256][RC4_BATCH] __attribute__((aligned(16)));
+    uint8_t jv[RC4_BATCH] __attribute__((aligned(16)));
+    size_t rows = keylen < 256 ? keylen : 256;
+
+    for (size_t m = 0; m < rows; ++m)
+        for (int k = 0; k < RC4_BATCH; ++k)
+            K[m][k] = keys[k < n ? k : 0][m];
+    for (int x = 0; x < 256; ++x)
+        _mm_store_si128((__m128i *)b->S[x], _mm_set1_epi8((char)x));
+
+    __m128i j = _mm_setzero_si128();
+    size_t m = 0;
+    for (int i = 0; i < 256; ++i) {
+        __m128i row = _mm_load_si128((const __m128i *)b->S[i]);
+        j = _mm_add_epi8(j, _mm_add_epi8(row, _mm_load_si128((const __m128i *)K[m])));
+        _mm_store_si128((__m128i *)jv, j);
+        if (++m == rows) m = 0;
+
+        // Per lane: t = S_k[j_k]; S_k[j_k] = S_k[i]; S_k[i] = t.  If
+        // j_k == i the scatter writes the old value back, which the row
+        // store below then repeats.
+        uint8_t old[RC4_BATCH] __attribute__((aligned(16)));
+        uint8_t swapped[RC4_BATCH] __attribute__((aligned(16)));
+        _mm_store_si128((__m128i *)old, row);
+        for (int k = 0; k < RC4_BATCH; ++k) {
+            swapped[k] = b->S[jv[k]][k];
+            b->S[jv[k]][k] = old[k];
+        }
+        _mm_store_si128((__m128i *)b->S[i], _mm_load_si128((const __m128i *)swapped));
+    }
+    b->i = 0;
+    memset(b->j, 0, sizeof(b->j));
+}
+
+// Next len keystream bytes of every lane, out[t][k] = byte t of lane k
+static inline void rc4_batch_keystream(rc4_batch_t *b, uint8_t (*out)[RC4_BATCH], size_t len) {
+    uint8_t jv[RC4_BATCH] __attribute__((aligned(16)));
+    uint8_t old[RC4_BATCH] __attribute__((aligned(16)));
+    uint8_t sum[RC4_BATCH] __attribute__((aligned(16)));
+    __m128i j = _mm_load_si128((const __m128i *)b->j);
+    uint8_t i = b->i;
+
+    for (size_t t = 0; t < len; ++t) {
+        ++i;
+        __m128i row = _mm_load_si128((const __m128i *)b->S[i]);
+        j = _mm_add_epi8(j, row);
+        _mm_store_si128((__m128i *)jv, j);
+        _mm_store_si128((__m128i *)old, row);
+        for (int k = 0; k < RC4_BATCH; ++k) {
+            uint8_t v = b->S[jv[k]][k];
+            b->S[jv[k]][k] = old[k];
+            b->S[i][k] = v;
+            sum[k] = (uint8_t)(old[k] + v);
+        }
+        for (int k = 0; k < RC4_BATCH; ++k)
+            out[t][k] = b->S[sum[k]][k];
+    }
+    _mm_store_si128((__m128i *)b->j, j);
+    b->i = i;
+}
+
+// Copy lane k out as an ordinary state for rc4_crypt
+static inline void rc4_batch_extract(const rc4_batch_t *b, int k, rc4_state_t *st) {
+    for (int x = 0; x < 256; ++x) st->S[x] = b->S[x][k];
+    st->i = b->i;
+    st->j = b->j[k];
+}
+
+#endif // RC4_H
@@ -0,0 +1,141 @@
+// rc4ksa.c
+// Key-schedule throughput: scalar rc4_init per key vs rc4_init_batch
+// (RC4_BATCH keys at once, interleaved S-boxes), alone and followed by the
+// first OUT_BYTES keystream bytes as in key-search / WEP-audit jobs.
+//
+// Compile: gcc -O2 rc4ksa.c -o rc4ksa
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rc4.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+
+#define KEYLEN    16
+#define NKEYS     (1u << 18)   // keys per measurement, multiple of RC4_BATCH
+#define OUT_BYTES 16
+
+// Simple LCG for generating pseudo-random keys
+static uint32_t lcg_seed = 123456789;
+uint32_t lcg_rand() {
+    lcg_seed = (1103515245 * lcg_seed + 12345) & 0x7fffffff;
+    return lcg_seed;
+}
+
+void generate_random(uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        buf[i] = (uint8_t)(lcg_rand() & 0xff);
+    }
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Every lane must match rc4_init on its own key, for state and keystream
+static int batch_self_check(void) {
+    static const size_t keylens[] = { 1, 5, 13, 16, 40, 256 };
+    uint8_t keys[RC4_BATCH][256], ks[OUT_BYTES][RC4_BATCH], ref[OUT_BYTES];
+    const uint8_t *kp[RC4_BATCH];
+    rc4_batch_t b;
+    rc4_state_t st, lane;
+
+    for (size_t t = 0; t < sizeof(keylens) / sizeof(keylens[0]); ++t) {
+        for (int k = 0; k < RC4_BATCH; ++k) {
+            generate_random(keys[k], keylens[t]);
+            kp[k] = keys[k];
+        }
+        rc4_init_batch(&b, kp, keylens[t], RC4_BATCH - (int)t);
+        for (int k = 0; k < RC4_BATCH - (int)t; ++k) {
+            rc4_init(&st, keys[k], keylens[t]);
+            rc4_batch_extract(&b, k, &lane);
+            if (memcmp(st.S, lane.S, 256) != 0 || st.j != lane.j) return 0;
+        }
+        rc4_batch_keystream(&b, ks, OUT_BYTES);
+        for (int k = 0; k < RC4_BATCH - (int)t; ++k) {
+            rc4_init(&st, keys[k], keylens[t]);
+            memset(ref, 0, sizeof(ref));
+            rc4_crypt(&st, ref, sizeof(ref));
+            for (int i = 0; i < OUT_BYTES; ++i)
+                if (ks[i][k] != ref[i]) return 0;
+        }
+    }
+    return 1;
+}
+
+int main() {
+    bench_isolate(0);
+    bench_timing_init();
+
+    uint8_t *keys = malloc((size_t)NKEYS * KEYLEN);
+    rc4_state_t st;
+    rc4_batch_t b;
+    uint8_t out[OUT_BYTES], ks[OUT_BYTES][RC4_BATCH];
+    uint64_t sink = 0;
+
+    if (!keys) {
+        perror("Failed to allocate memory");
+        return 1;
+    }
+    if (!batch_self_check()) {
+        printf("Batch KSA self-check FAILED\n");
+        free(keys);
+        return 1;
+    }
+    printf("Batch KSA self-check against rc4_init: OK\n");
+    generate_random(keys, (size_t)NKEYS * KEYLEN);
+
+    for (int with_ks = 0; with_ks <= 1; ++with_ks) {
+        // Scalar: one key at a time
+        double t0 = now_sec();
+        uint64_t c0 = bench_tsc_start();
+        for (uint32_t n = 0; n < NKEYS; ++n) {
+            rc4_init(&st, keys + (size_t)n * KEYLEN, KEYLEN);
+            if (with_ks) {
+                memset(out, 0, sizeof(out));
+                rc4_crypt(&st, out, sizeof(out));
+                sink += out[0];
+            } else {
+                sink += st.S[0];
+            }
+        }
+        uint64_t scalar_cycles = bench_elapsed(c0, bench_tsc_stop());
+        double t1 = now_sec();
+
+
+        // Batched: RC4_BATCH keys per call
+        uint64_t c1 = bench_tsc_start();
+        for (uint32_t n = 0; n < NKEYS; n += RC4_BATCH) {
+            const uint8_t *kp[RC4_BATCH];
+            for (int k = 0; k < RC4_BATCH; ++k) kp[k] = keys + (size_t)(n + k) * KEYLEN;
+            rc4_init_batch(&b, kp, KEYLEN, RC4_BATCH);
+            if (with_ks) {
+                rc4_batch_keystream(&b, ks, OUT_BYTES);
+                sink += ks[0][0];
+            } else {
+                sink += b.S[0][0];
+            }
+        }
+        uint64_t batch_cycles = bench_elapsed(c1, bench_tsc_stop());
+        double t2 = now_sec();
+
+        double scalar_rate = NKEYS / (t1 - t0), batch_rate = NKEYS / (t2 - t1);
+        printf("\n%s (%u keys of %d bytes):\n",
+               with_ks ? "KSA + first 16 keystream bytes" : "KSA only", NKEYS, KEYLEN);
+        printf("  scalar rc4_init : %12.0f keys/s  %8.1f cycles/key\n",
+               scalar_rate, (double)scalar_cycles / NKEYS);
+        printf("  rc4_init_batch  : %12.0f keys/s  %8.1f cycles/key  (%.2fx)\n",
+               batch_rate, (double)batch_cycles / NKEYS, batch_rate / scalar_rate);
+    }
+    printf("\n(sink %llu)\n", (unsigned long long)(sink & 1));
+
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// rngbench.c
+// Random bytes/sec: libc rand() (as MR.c used it, three calls per 64-bit
+// limb) vs getrandom() per request vs the ChaCha20 generator in chacha_rng.h,
+// single-threaded and with all threads pulling at once.
+//
+// Compile: gcc -O2 -pthread rngbench.c -o rngbench
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "chacha_rng.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+
+#define TOTAL_BYTES (64u << 20)   // per thread per measurement
+
+typedef enum { SRC_RAND, SRC_GETRANDOM, SRC_RNG } rng_source_t;
+
+typedef struct {
+    rng_source_t src;
+    size_t req;        // bytes per request
+    size_t total;
+    uint64_t sink;     // keeps the compiler from dropping the work
+} bench_job_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// The old big_rand limb: three rand() calls per 64 bits
+static uint64_t rand_u64(void) {
+    uint64_t r = (((uint64_t)rand() << 32) ^ rand());
+    return (r << 32) ^ rand();
+}
+
+static void *bench_worker(void *arg) {
+    bench_job_t *job = (bench_job_t *)arg;
+    uint8_t buf[4096];
+    uint64_t acc = 0;
+
+    for (size_t done = 0; done < job->total; done += job->req) {
+        switch (job->src) {
+        case SRC_RAND:
+            for (size_t i = 0; i < job->req; i += 8) {
+                uint64_t v = rand_u64();
+                memcpy(buf + i, &v, 8);
+            }
+            break;
+        case SRC_GETRANDOM:
+            rng_getentropy(buf, job->req);
+            break;
+        case SRC_RNG:
+            rng_bytes(buf, job->req);
+            break;
+        }
+        acc += buf[0];
+    }
+    job->sink = acc;
+    return NULL;
+}
+
+// Aggregate bytes/sec over nthreads threads
+static double bench_run(rng_source_t src, size_t req, size_t total, int nthreads) {
+    pthread_t th[64];
+    bench_job_t jobs[64];
+
+    for (int t = 0; t < nthreads; ++t) jobs[t] = (bench_job_t){ src, req, total, 0 };
+    double t0 = now_sec();
+    for (int t = 1; t < nthreads; ++t) pthread_create(&th[t], NULL, bench_worker, &jobs[t]);
+    bench_worker(&jobs[0]);
+    for (int t = 1; t < nthreads; ++t) pthread_join(th[t], NULL);
+    double t1 = now_sec();
+    return (double)total * nthreads / (t1 - t0);
+}
+
+int main(void) {
+    bench_isolate(BENCH_ALL_CPUS);
+    bench_timing_init();
+
+    static const size_t reqs[] = { 8, 64, 4096 };
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = (ncpu < 1) ? 1 : (ncpu > 64 ? 64 : (int)ncpu);
+
+    srand(1);
+
+    // Cycles per 64-bit value, rand() vs rng_u64()
+    uint64_t c0 = bench_tsc_start(), acc = 0;
+    for (int i = 0; i < 1000000; ++i) acc += rand_u64();
+    uint64_t rand_cycles = bench_elapsed(c0, bench_tsc_stop());
+    uint64_t c1 = bench_tsc_start();
+    for (int i = 0; i < 1000000; ++i) acc += rng_u64();
+    uint64_t rng_cycles = bench_elapsed(c1, bench_tsc_stop());
+    printf("Cycles per 64-bit value: rand() x3 %.1f, rng_u64 %.1f (sink %llu)\n\n",
+           (double)rand_cycles / 1e6, (double)rng_cycles / 1e6, (unsigned long long)(acc & 1));
+
+    printf("%-12s %8s %16s\n", "source", "request", "1 thread MB/s");
+    for (size_t r = 0; r < sizeof(reqs) / sizeof(reqs[0]); ++r) {
+        double a = bench_run(SRC_RAND, reqs[r], TOTAL_BYTES / 8, 1);
+        double b = bench_run(SRC_GETRANDOM, reqs[r], TOTAL_BYTES / 8, 1);
+        double c = bench_run(SRC_RNG, reqs[r], TOTAL_BYTES, 1);
+        printf("%-12s %8zu %16.1f\n", "rand()", reqs[r], a / 1e6);
+        printf("%-12s %8zu %16.1f\n", "getrandom()", reqs[r], b / 1e6);
+        printf("%-12s %8zu %16.1f  (%.1fx rand)\n", "chacha_rng", reqs[r], c / 1e6, c / a);
+    }
+
+    printf("\nAll %d threads, 64-byte requests (aggregate MB/s):\n", nthreads);
+    double a = bench_run(SRC_RAND, 64, TOTAL_BYTES / 8, nthreads);
+    double c = bench_run(SRC_RNG, 64, TOTAL_BYTES, nthreads);
+    printf("  rand()     : %10.1f\n", a / 1e6);
+    printf("  chacha_rng : %10.1f  (%.1fx)\n", c / 1e6, c / a);
+    return 0;
+}
@@ -1,12 +1,18 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
-#include <x86intrin.h> // __rdtsc
 #include <gmp.h>       // GMP
+#include "sha256.h"
+#include "chacha_rng.h"
+#include "bench_env.h"
+#include "bench_timing.h"
 
 #define MAX_LEN 1024
+#define MAX_MOD_BYTES 512    // moduli up to 4096 bits in decrypt mode
+#define BENCH_REPS 20        // runs per encoding in the comparison
 
 uint64_t modexp(uint64_t base, uint64_t exp, uint64_t mod)
 {
@@ -51,34 +57,299 @@ int64_t modinv(int64_t a, int64_t m)
     return (x1 < 0) ? x1 + m0 : x1;
 }
 
-// Generate 512-bit prime using GMP
+// Generate 512-bit prime using GMP.  The generator is seeded once per
+// process: reseeding from time(NULL) on every call returned p == q.
 void generate_512bit_prime(mpz_t prime)
 {
-    gmp_randstate_t state;
-    gmp_randinit_default(state);
-    gmp_randseed_ui(state, time(NULL));
+    static gmp_randstate_t state;
+    static int seeded = 0;
+    if (!seeded)
+    {
+        gmp_randinit_default(state);
+        gmp_randseed_ui(state, time(NULL));
+        seeded = 1;
+    }
 
     mpz_urandomb(prime, state, 512); // generate 512-bit random number
     mpz_nextprime(prime, prime);    // get next prime
-    gmp_randclear(state);
+}
+
+// CRT private key: dP = d mod (p-1), dQ = d mod (q-1), qInv = q^-1 mod p
+typedef struct
+{
+    mpz_t p, q, dP, dQ, qInv;
+} rsa_priv_t;
+
+void rsa_priv_init(rsa_priv_t *k, const mpz_t p, const mpz_t q, const mpz_t d)
+{
+    mpz_inits(k->p, k->q, k->dP, k->dQ, k->qInv, NULL);
+    mpz_set(k->p, p);
+    mpz_set(k->q, q);
+    mpz_sub_ui(k->dP, p, 1);
+    mpz_mod(k->dP, d, k->dP);
+    mpz_sub_ui(k->dQ, q, 1);
+    mpz_mod(k->dQ, d, k->dQ);
+    mpz_invert(k->qInv, q, p);
+}
+
+void rsa_priv_clear(rsa_priv_t *k)
+{
+    mpz_clears(k->p, k->q, k->dP, k->dQ, k->qInv, NULL);
+}
+
+// m = c^d mod n as two half-size exponentiations plus Garner's recombination
+void rsa_decrypt_crt(mpz_t m, const mpz_t c, const rsa_priv_t *k)
+{
+    mpz_t m1, m2, h;
+    mpz_inits(m1, m2, h, NULL);
+    mpz_mod(m1, c, k->p);
+    mpz_powm(m1, m1, k->dP, k->p);
+    mpz_mod(m2, c, k->q);
+    mpz_powm(m2, m2, k->dQ, k->q);
+    mpz_sub(h, m1, m2);
+    mpz_mul(h, h, k->qInv);
+    mpz_mod(h, h, k->p);
+    mpz_mul(m, h, k->q);
+    mpz_add(m, m, m2);
+    mpz_clears(m1, m2, h, NULL);
+}
+
+// --- Message encoding ---
+// char:  one byte per exponentiation, the value of the byte itself (the
+//        original scheme; deterministic, kept for comparison)
+// block: 0x01 || up to k - 2 message bytes per block, k = modulus bytes;
+//        the leading 0x01 keeps leading zero bytes, and the value stays
+//        below 2^(8(k-1)) <= n.  Deterministic, like char.
+// oaep:  RSAES-OAEP (RFC 8017) with SHA-256, MGF1-SHA256 and an empty
+//        label, up to k - 66 message bytes per block; randomised
+
+enum { ENC_CHAR, ENC_BLOCK, ENC_OAEP, ENCODINGS };
+
+static const char *const encoding_names[ENCODINGS] = { "char", "block", "oaep" };
+
+// Bytes of n such that every k-1 byte value is below n
+static size_t rsa_modulus_bytes(const mpz_t n)
+{
+    return (mpz_sizeinbase(n, 2) - 1) / 8 + 1;
+}
+
+static size_t rsa_block_capacity(int enc, size_t k)
+{
+    return enc == ENC_CHAR ? 1 : enc == ENC_BLOCK ? k - 2 : k - 2 * SHA256_DIGEST_LEN - 2;
+}
+
+// out ^= MGF1-SHA256(seed), outlen bytes
+static void mgf1_xor(uint8_t *out, size_t outlen, const uint8_t *seed, size_t seedlen)
+{
+    uint8_t digest[SHA256_DIGEST_LEN];
+    for (uint32_t counter = 0; outlen > 0; counter++)
+    {
+        uint8_t cbuf[4] = { (uint8_t)(counter >> 24), (uint8_t)(counter >> 16),
+                            (uint8_t)(counter >> 8), (uint8_t)counter };
+        sha256_ctx_t ctx;
+        sha256_init(&ctx);
+        sha256_update(&ctx, seed, seedlen);
+        sha256_update(&ctx, cbuf, 4);
+        sha256_final(&ctx, digest);
+        size_t take = outlen < SHA256_DIGEST_LEN ? outlen : SHA256_DIGEST_LEN;
+        for (size_t i = 0; i < take; i++) *out++ ^= digest[i];
+        outlen -= take;
+    }
+}
+
+// EM = 0x00 || maskedSeed || maskedDB, DB = lHash || 0..0 || 0x01 || msg
+static void oaep_encode(uint8_t *em, size_t k, const uint8_t *msg, size_t len)
+{
+    uint8_t *seed = em + 1, *db = em + 1 + SHA256_DIGEST_LEN;
+    size_t dblen = k - SHA256_DIGEST_LEN - 1;
+
+    em[0] = 0x00;
+    sha256(db, (const uint8_t *)"", 0);
+    memset(db + SHA256_DIGEST_LEN, 0, dblen - SHA256_DIGEST_LEN - len - 1);
+    db[dblen - len - 1] = 0x01;
+    memcpy(db + dblen - len, msg, len);
+    rng_bytes(seed, SHA256_DIGEST_LEN);
+    mgf1_xor(db, dblen, seed, SHA256_DIGEST_LEN);
+    mgf1_xor(seed, SHA256_DIGEST_LEN, db, dblen);
+}
+
+// Message bytes of em written to out, or -1 if em is not a valid encoding
+static long oaep_decode(uint8_t *out, uint8_t *em, size_t k)
+{
+    uint8_t *seed = em + 1, *db = em + 1 + SHA256_DIGEST_LEN, lhash[SHA256_DIGEST_LEN];
+    size_t dblen = k - SHA256_DIGEST_LEN - 1, i;
+
+    mgf1_xor(seed, SHA256_DIGEST_LEN, db, dblen);
+    mgf1_xor(db, dblen, seed, SHA256_DIGEST_LEN);
+    sha256(lhash, (const uint8_t *)"", 0);
+    if (em[0] != 0x00 || memcmp(db, lhash, SHA256_DIGEST_LEN) != 0) return -1;
+    for (i = SHA256_DIGEST_LEN; i < dblen && db[i] == 0x00; i++)
+        ;
+    if (i == dblen || db[i] != 0x01) return -1;
+    memcpy(out, db + i + 1, dblen - i - 1);
+    return (long)(dblen - i - 1);
+}
+
+// m = encoding of data[0..len), len <= rsa_block_capacity(enc, k)
+static void rsa_encode(int enc, mpz_t m, const uint8_t *data, size_t len, size_t k)
+{
+    uint8_t buf[MAX_MOD_BYTES];
+    if (enc == ENC_CHAR)
+    {
+        mpz_set_ui(m, data[0]);
+    }
+    else if (enc == ENC_BLOCK)
+    {
+        buf[0] = 0x01;
+        memcpy(buf + 1, data, len);
+        mpz_import(m, len + 1, 1, 1, 0, 0, buf);
+    }
+    else
+    {
+        oaep_encode(buf, k, data, len);
+        mpz_import(m, k, 1, 1, 0, 0, buf);
+    }
+}
+
+// Message bytes of m written to out, or -1 for a malformed block
+static long rsa_decode(int enc, uint8_t *out, const mpz_t m, size_t k)
+{
+    uint8_t buf[MAX_MOD_BYTES];
+    size_t count;
+    if (mpz_sizeinbase(m, 256) > k) return -1;
+    if (enc == ENC_CHAR)
+    {
+        if (mpz_cmp_ui(m, 255) > 0) return -1;
+        out[0] = (uint8_t)mpz_get_ui(m);
+        return 1;
+    }
+    if (enc == ENC_BLOCK)
+    {
+        mpz_export(buf, &count, 1, 1, 0, 0, m);
+        if (count == 0 || buf[0] != 0x01) return -1;
+        memcpy(out, buf + 1, count - 1);
+        return (long)(count - 1);
+    }
+    // OAEP: left-pad to k bytes, the leading 0x00 is part of the encoding
+    mpz_export(buf, &count, 1, 1, 0, 0, m);
+    memmove(buf + k - count, buf, count);
+    memset(buf, 0, k - count);
+    return oaep_decode(out, buf, k);
+}
+
+// Encrypts len bytes into ceil(len / capacity) ciphertexts in c[];
+// returns the number of blocks
+static size_t rsa_encrypt_msg(int enc, mpz_t *c, const uint8_t *msg, size_t len, const mpz_t e, const mpz_t n)
+{
+    size_t k = rsa_modulus_bytes(n), cap = rsa_block_capacity(enc, k), blocks = 0;
+    mpz_t m;
+    mpz_init(m);
+    for (size_t off = 0; off < len; off += cap, blocks++)
+    {
+        size_t take = len - off < cap ? len - off : cap;
+        rsa_encode(enc, m, msg + off, take, k);
+        mpz_powm(c[blocks], m, e, n);
+    }
+    mpz_clear(m);
+    return blocks;
+}
+
+// Decrypts blocks ciphertexts (CRT when key is given) into out; returns
+// the message length, or -1 if a block does not decode
+static long rsa_decrypt_msg(int enc, uint8_t *out, mpz_t *c, size_t blocks, const mpz_t d, const mpz_t n,
+                            const rsa_priv_t *key)
+{
+    size_t k = rsa_modulus_bytes(n);
+    long len = 0;
+    mpz_t m;
+    mpz_init(m);
+    for (size_t i = 0; i < blocks; i++)
+    {
+        if (key)
+            rsa_decrypt_crt(m, c[i], key);
+        else
+            mpz_powm(m, c[i], d, n);
+        long got = rsa_decode(enc, out + len, m, k);
+        if (got < 0)
+        {
+            len = -1;
+            break;
+        }
+        len += got;
+    }
+    mpz_clear(m);
+    return len;
+}
+
+static int read_encoding(void)
+{
+    char name[16];
+    printf("Enter encoding (char/block/oaep): ");
+    if (scanf("%15s", name) != 1) return -1;
+    for (int enc = 0; enc < ENCODINGS; enc++)
+        if (strcmp(name, encoding_names[enc]) == 0) return enc;
+    return -1;
+}
+
+// Every encoding on the same message, BENCH_REPS times each: blocks
+// (exponentiations), and bytes/s for encryption and CRT decryption
+static void bench_encodings(const uint8_t *msg, size_t len, const mpz_t e, const mpz_t d, const mpz_t n,
+                            const rsa_priv_t *key, mpz_t *c)
+{
+    uint8_t out[MAX_LEN];
+    size_t k = rsa_modulus_bytes(n);
+
+    printf("\n%zu-byte message, %zu-byte modulus, %d runs per encoding:\n", len, k, BENCH_REPS);
+    for (int enc = 0; enc < ENCODINGS; enc++)
+    {
+        uint64_t enc_cycles = 0, dec_cycles = 0;
+        size_t blocks = 0;
+        int ok = 1;
+        for (int r = 0; r < BENCH_REPS; r++)
+        {
+            uint64_t s0 = bench_tsc_start();
+            blocks = rsa_encrypt_msg(enc, c, msg, len, e, n);
+            uint64_t s1 = bench_tsc_stop();
+            enc_cycles += bench_elapsed(s0, s1);
+
+            s0 = bench_tsc_start();
+            long got = rsa_decrypt_msg(enc, out, c, blocks, d, n, key);
+            s1 = bench_tsc_stop();
+            dec_cycles += bench_elapsed(s0, s1);
+            ok &= got == (long)len && memcmp(out, msg, len) == 0;
+        }
+        double bytes = (double)len * BENCH_REPS;
+        printf("  %-5s %4zu blocks of <= %3zu bytes: encrypt %10.0f bytes/s, decrypt (CRT) %9.0f bytes/s%s\n",
+               encoding_names[enc], blocks, rsa_block_capacity(enc, k), bytes / (bench_ns((double)enc_cycles) / 1e9),
+               bytes / (bench_ns((double)dec_cycles) / 1e9), ok ? "" : "  ROUND TRIP FAILED");
+    }
 }
 
 int main()
 {
-    srand(time(NULL));
+    bench_isolate(0);
+    bench_timing_init();
+
     char mode[16];
     printf("Enter mode (encrypt/decrypt): ");
-    scanf("%s", mode);
-    getchar();
+    scanf("%15s", mode);
 
     if (strcmp(mode, "encrypt") == 0)
     {
+        int enc = read_encoding();
+        getchar();
+        if (enc < 0)
+        {
+            printf("Invalid encoding.\n");
+            return 1;
+        }
+
         // GMP variables
         mpz_t p, q, n, phi, e, d, p1, q1;
         mpz_inits(p, q, n, phi, e, d, p1, q1, NULL);
 
         // Generate 512-bit primes
-        uint64_t start_gen = __rdtsc();
+        uint64_t start_gen = bench_tsc_start();
         generate_512bit_prime(p);
         generate_512bit_prime(q);
 
@@ -104,11 +375,16 @@ int main()
         }
 
         mpz_invert(d, e, phi);
-        uint64_t end_gen = __rdtsc();
+        uint64_t end_gen = bench_tsc_stop();
+
+        rsa_priv_t key;
+        rsa_priv_init(&key, p, q, d);
 
         printf("\nGenerated RSA Parameters:\n");
         gmp_printf("p = %Zd\nq = %Zd\nn = %Zd\nphi(n) = %Zd\ne = %Zd\nd = %Zd\n", p, q, n, phi, e, d);
-        printf("Clock cycles for key generation: %llu\n", end_gen - start_gen);
+        gmp_printf("dP = %Zd\ndQ = %Zd\nqInv = %Zd\n", key.dP, key.dQ, key.qInv);
+        printf("Clock cycles for key generation: %llu (%.0f ns)\n", (unsigned long long)bench_elapsed(start_gen, end_gen),
+               bench_ns((double)bench_elapsed(start_gen, end_gen)));
 
         // Input plaintext
         char plaintext[MAX_LEN];
@@ -117,54 +393,127 @@ int main()
         plaintext[strcspn(plaintext, "\n")] = '\0';
 
         size_t len = strlen(plaintext);
-        mpz_t m, c;
-        mpz_inits(m, c, NULL);
-        uint64_t start_enc = __rdtsc();
+        const uint8_t *msg = (const uint8_t *)plaintext;
+        mpz_t *c = malloc(MAX_LEN * sizeof(mpz_t));
+        for (size_t i = 0; i < MAX_LEN; i++) mpz_init(c[i]);
+
+        uint64_t start_enc = bench_tsc_start();
+        size_t blocks = rsa_encrypt_msg(enc, c, msg, len, e, n);
+        uint64_t end_enc = bench_tsc_stop();
 
-        printf("\nCiphertext:\n");
-        for (size_t i = 0; i < len; i++)
+        printf("\nCiphertext (%s encoding, %zu blocks):\n", encoding_names[enc], blocks);
+        for (size_t i = 0; i < blocks; i++)
+            gmp_printf("%Zd ", c[i]);
+        printf("\nClock cycles for encryption: %llu (%.0f ns)\n", (unsigned long long)bench_elapsed(start_enc, end_enc),
+               bench_ns((double)bench_elapsed(start_enc, end_enc)));
+        if (len > 0)
+            printf("Average cycles per byte: %.2f\n", (double)bench_elapsed(start_enc, end_enc) / len);
+
+        // Decrypt every block both ways: full c^d mod n and CRT
+        mpz_t full, crt;
+        mpz_inits(full, crt, NULL);
+        uint64_t full_cycles = 0, crt_cycles = 0;
+        int ok = 1;
+        for (size_t i = 0; i < blocks; i++)
         {
-            mpz_set_ui(m, (unsigned char)plaintext[i]);
-            mpz_powm(c, m, e, n);
-            gmp_printf("%Zd ", c);
+            uint64_t s0 = bench_tsc_start();
+            mpz_powm(full, c[i], d, n);
+            uint64_t s1 = bench_tsc_stop();
+            full_cycles += bench_elapsed(s0, s1);
+
+            s0 = bench_tsc_start();
+            rsa_decrypt_crt(crt, c[i], &key);
+            s1 = bench_tsc_stop();
+            crt_cycles += bench_elapsed(s0, s1);
+
+            ok &= mpz_cmp(full, crt) == 0;
         }
-        uint64_t end_enc = __rdtsc();
+        uint8_t out[MAX_LEN];
+        ok &= rsa_decrypt_msg(enc, out, c, blocks, d, n, &key) == (long)len && memcmp(out, msg, len) == 0;
+        printf("Decryption check: %s\n", ok ? "OK" : "FAILED");
+        if (blocks > 0)
+            printf("Cycles per decryption: full %.0f, CRT %.0f (%.2fx)\n", (double)full_cycles / blocks,
+                   (double)crt_cycles / blocks, (double)full_cycles / (double)crt_cycles);
 
-        printf("\nClock cycles for encryption: %llu\n", end_enc - start_enc);
-        printf("Average cycles per byte: %.2f\n", (double)(end_enc - start_enc) / len);
+        if (len > 0)
+            bench_encodings(msg, len, e, d, n, &key, c);
 
-        mpz_clears(p, q, n, phi, e, d, p1, q1, m, c, NULL);
+        for (size_t i = 0; i < MAX_LEN; i++) mpz_clear(c[i]);
+        free(c);
+        rsa_priv_clear(&key);
+        mpz_clears(p, q, n, phi, e, d, p1, q1, full, crt, NULL);
     }
     else if (strcmp(mode, "decrypt") == 0)
     {
-        mpz_t n, d, c, m;
-        mpz_inits(n, d, c, m, NULL);
+        int enc = read_encoding();
+        if (enc < 0)
+        {
+            printf("Invalid encoding.\n");
+            return 1;
+        }
+
+        mpz_t n, d, p, q, pq;
+        mpz_inits(n, d, p, q, pq, NULL);
 
         printf("Enter modulus n: ");
         gmp_scanf("%Zd", n);
         printf("Enter private exponent d: ");
         gmp_scanf("%Zd", d);
-        getchar();
+        printf("Enter primes p and q for CRT (0 0 to use n and d only): ");
+        gmp_scanf("%Zd %Zd", p, q);
 
-        printf("Enter ciphertext (space-separated, end with -1):\n");
-        char line[8192];
-        fgets(line, sizeof(line), stdin);
-        char *token = strtok(line, " ");
-        uint64_t start_dec = __rdtsc();
+        // CRT only when the factors really belong to n
+        rsa_priv_t key;
+        mpz_mul(pq, p, q);
+        int use_crt = mpz_cmp_ui(p, 1) > 0 && mpz_cmp_ui(q, 1) > 0 && mpz_cmp(pq, n) == 0;
+        if (use_crt)
+            rsa_priv_init(&key, p, q, d);
+        else if (mpz_sgn(p) != 0 || mpz_sgn(q) != 0)
+            printf("p * q != n, decrypting without CRT\n");
 
-        printf("\nDecrypted text:\n");
-        while (token && strcmp(token, "-1") != 0)
+        size_t k = rsa_modulus_bytes(n);
+        if (k > MAX_MOD_BYTES || k < 3 || (enc == ENC_OAEP && k < 2 * SHA256_DIGEST_LEN + 3))
+        {
+            printf("Modulus size not supported.\n");
+            return 1;
+        }
+
+        // One number per block, until -1
+        printf("Enter ciphertext (space-separated, end with -1):\n");
+        mpz_t *c = malloc(MAX_LEN * sizeof(mpz_t));
+        size_t blocks = 0;
+        for (; blocks < MAX_LEN; blocks++)
         {
-            mpz_set_str(c, token, 10);
-            mpz_powm(m, c, d, n);
-            printf("%c", (char)mpz_get_ui(m));
-            token = strtok(NULL, " ");
+            mpz_init(c[blocks]);
+            if (gmp_scanf("%Zd", c[blocks]) != 1 || mpz_sgn(c[blocks]) < 0)
+            {
+                mpz_clear(c[blocks]);
+                break;
+            }
         }
 
-        uint64_t end_dec = __rdtsc();
-        printf("\nClock cycles for decryption: %llu\n", end_dec - start_dec);
+        uint8_t *out = malloc(MAX_LEN * MAX_MOD_BYTES);
+        uint64_t start_dec = bench_tsc_start();
+        long len = rsa_decrypt_msg(enc, out, c, blocks, d, n, use_crt ? &key : NULL);
+        uint64_t end_dec = bench_tsc_stop();
+
+        printf("\nDecrypted text:\n");
+        if (len < 0)
+            printf("(a block did not decode as %s)", encoding_names[enc]);
+        else
+            fwrite(out, 1, (size_t)len, stdout);
+        printf("\nClock cycles for decryption%s: %llu (%.0f ns)\n", use_crt ? " (CRT)" : "",
+               (unsigned long long)bench_elapsed(start_dec, end_dec),
+               bench_ns((double)bench_elapsed(start_dec, end_dec)));
+        if (len > 0)
+            printf("Average cycles per byte: %.2f\n", (double)bench_elapsed(start_dec, end_dec) / len);
 
-        mpz_clears(n, d, c, m, NULL);
+        for (size_t i = 0; i < blocks; i++) mpz_clear(c[i]);
+        free(c);
+        free(out);
+        if (use_crt)
+            rsa_priv_clear(&key);
+        mpz_clears(n, d, p, q, pq, NULL);
     }
     else
     {
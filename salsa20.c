@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include "keystream.h"
 
 #define ROUNDS 20  // 20 rounds is standard for Salsa20
 
@@ -43,57 +44,99 @@ uint32_t U8TO32_LE(const uint8_t *p) {
            ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
+// Helper to convert 32-bit little-endian to bytes
+void U32TO8_LE(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+// "expand 32-byte k" as little-endian words
+static const uint32_t sigma[4] = {
+    0x61707865, 0x3320646e, 0x79622d32, 0x6b206574
+};
+
 // Fill input state (16x 32-bit words) using key, nonce, counter
 void salsa20_keysetup(uint32_t input[16], const uint8_t key[32], const uint8_t nonce[8], uint64_t counter) {
-    const char *constants = "expand 32-byte k";
-
-    input[0] = U8TO32_LE((const uint8_t *)(constants + 0));
+    input[0] = sigma[0];
     input[1] = U8TO32_LE(key + 0);
     input[2] = U8TO32_LE(key + 4);
     input[3] = U8TO32_LE(key + 8);
     input[4] = U8TO32_LE(key + 12);
-    input[5] = U8TO32_LE((const uint8_t *)(constants + 4));
+    input[5] = sigma[1];
     input[6] = U8TO32_LE(nonce + 0);
     input[7] = U8TO32_LE(nonce + 4);
     input[8] = (uint32_t)(counter & 0xFFFFFFFF);
     input[9] = (uint32_t)(counter >> 32);
-    input[10] = U8TO32_LE((const uint8_t *)(constants + 8));
+    input[10] = sigma[2];
     input[11] = U8TO32_LE(key + 16);
     input[12] = U8TO32_LE(key + 20);
     input[13] = U8TO32_LE(key + 24);
     input[14] = U8TO32_LE(key + 28);
-    input[15] = U8TO32_LE((const uint8_t *)(constants + 12));
+    input[15] = sigma[3];
 }
 
-void salsa20_encrypt(const uint8_t *key, const uint8_t *nonce, const uint8_t *in, uint8_t *out, size_t len) {
-    uint32_t input[16], keystream[16];
-    uint8_t block[64];
-    uint64_t counter = 0;
-    size_t i, j;
-
-    while (len > 0) {
-        salsa20_keysetup(input, key, nonce, counter);
-        salsa20_block(keystream, input);
-
-        for (i = 0; i < 16; ++i) {
-            block[4*i + 0] = keystream[i] & 0xff;
-            block[4*i + 1] = (keystream[i] >> 8) & 0xff;
-            block[4*i + 2] = (keystream[i] >> 16) & 0xff;
-            block[4*i + 3] = (keystream[i] >> 24) & 0xff;
-        }
-
-        size_t block_size = (len < 64) ? len : 64;
-
-        for (j = 0; j < block_size; ++j)
-            out[j] = in[j] ^ block[j];
-
-        len -= block_size;
-        in += block_size;
-        out += block_size;
-        counter++;
+// Streaming context: the key is parsed once, after that only the block
+// counter (words 8, 9) changes.  Keystream left over from a partial block
+// is kept so the next update call continues exactly where this one stopped.
+typedef struct {
+    uint32_t input[16];     // constants, key, nonce, 64-bit block counter
+    uint8_t keystream[64];  // keystream of the last generated block
+    size_t ks_used;         // bytes of keystream[] already consumed (64 = none left)
+} salsa20_ctx_t;
+
+void salsa20_init(salsa20_ctx_t *ctx, const uint8_t key[32], const uint8_t nonce[8], uint64_t counter) {
+    salsa20_keysetup(ctx->input, key, nonce, counter);
+    ctx->ks_used = 64;
+}
+
+void salsa20_update(salsa20_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t len) {
+    uint8_t keystream[KEYSTREAM_BATCH] __attribute__((aligned(KEYSTREAM_ALIGN)));
+
+    // Drain keystream buffered by the previous call
+    if (ctx->ks_used < 64) {
+        size_t take = (len < 64 - ctx->ks_used) ? len : 64 - ctx->ks_used;
+        keystream_xor(out, in, ctx->keystream + ctx->ks_used, take);
+        ctx->ks_used += take;
+        in += take;
+        out += take;
+        len -= take;
+    }
+
+    // Whole blocks: keystream in batches, XORed 64 bytes at a time
+    while (len >= 64) {
+        size_t take = (len > sizeof(keystream)) ? sizeof(keystream) : (len & ~(size_t)63);
+        salsa20_keystream(keystream, ctx->input, take / 64, ROUNDS);
+        keystream_xor(out, in, keystream, take);
+        len -= take;
+        in += take;
+        out += take;
+    }
+
+    // Partial block: keep the unused tail for the next call
+    if (len > 0) {
+        salsa20_keystream(ctx->keystream, ctx->input, 1, ROUNDS);
+        keystream_xor(out, in, ctx->keystream, len);
+        ctx->ks_used = len;
     }
 }
 
+// Wipe key material and buffered keystream
+void salsa20_final(salsa20_ctx_t *ctx) {
+    volatile uint8_t *p = (volatile uint8_t *)ctx;
+    for (size_t i = 0; i < sizeof(*ctx); ++i)
+        p[i] = 0;
+}
+
+// One-shot encryption starting at block counter 0
+void salsa20_encrypt(const uint8_t *key, const uint8_t *nonce, const uint8_t *in, uint8_t *out, size_t len) {
+    salsa20_ctx_t ctx;
+    salsa20_init(&ctx, key, nonce, 0);
+    salsa20_update(&ctx, in, out, len);
+    salsa20_final(&ctx);
+}
+
 // ---- MAIN FOR DEMO ----
 int main() {
     const uint8_t key[32] = {0};      // 256-bit key (all zero for demo)
@@ -106,7 +149,7 @@ int main() {
     size_t len = strlen(plaintext);
     if (plaintext[len - 1] == '\n') plaintext[--len] = '\0';
 
-    uint8_t ciphertext[64], decrypted[64];
+    uint8_t ciphertext[64], decrypted[64], oneshot[64];
 
     // Encrypt
     salsa20_encrypt(key, nonce, (uint8_t *)plaintext, ciphertext, len);
@@ -116,11 +159,25 @@ int main() {
         printf("%02x", ciphertext[i]);
     printf("\n");
 
-    // Decrypt
-    salsa20_encrypt(key, nonce, ciphertext, decrypted, len);
+    // Decrypt through the streaming context in uneven fragments, then
+    // check the result against a one-shot decryption
+    salsa20_ctx_t ctx;
+    size_t pos = 0, step = 1;
+    salsa20_init(&ctx, key, nonce, 0);
+    while (pos < len) {
+        size_t take = (len - pos < step) ? len - pos : step;
+        salsa20_update(&ctx, ciphertext + pos, decrypted + pos, take);
+        pos += take;
+        step = step * 2 + 1;
+    }
+    salsa20_final(&ctx);
     decrypted[len] = '\0';
 
     printf("Decrypted text: %s\n", decrypted);
 
+    salsa20_encrypt(key, nonce, ciphertext, oneshot, len);
+    printf("Fragmented == one-shot decryption: %s\n",
+           memcmp(decrypted, oneshot, len) == 0 ? "OK" : "FAILED");
+
     return 0;
 }
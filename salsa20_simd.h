@@ -0,0 +1,310 @@
+// salsa20_simd.h
+// SSE2 and AVX2 Salsa20 kernels (header-only, shared by the Salsa20 programs)
+//
+// State layout is the standard one from the Salsa20 spec:
+//   constants x0 x5 x10 x15, key x1..x4 x11..x14, nonce x6 x7,
+//   64-bit block counter x8 (low) x9 (high).
+//
+// Single block: the 4x4 matrix is held as its four diagonals
+//   a = (x0,  x5,  x10, x15)
+//   b = (x4,  x9,  x14, x3 )
+//   c = (x8,  x13, x2,  x7 )
+//   d = (x12, x1,  x6,  x11)
+// so the column round is one vector quarterround, and the row round is the
+// same quarterround after rotating b, c, d by 3, 2, 1 lanes.
+//
+// Multi block: word-sliced, vector k holds word k of 4 (SSE2) or 8 (AVX2)
+// consecutive blocks; the result is transposed back to byte order on store.
+//
+// Every kernel computes out = in ^ keystream; pass in == NULL to write the
+// raw keystream instead.  Kernels do not advance the counter in st[].
+
+#ifndef SALSA20_SIMD_H
+#define SALSA20_SIMD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#define SALSA_ROTL_SSE2(v, c) \
+    _mm_or_si128(_mm_slli_epi32((v), (c)), _mm_srli_epi32((v), 32 - (c)))
+#define SALSA_ROTL_AVX2(v, c) \
+    _mm256_or_si256(_mm256_slli_epi32((v), (c)), _mm256_srli_epi32((v), 32 - (c)))
+
+// Quarterround on word-sliced vectors
+#define SALSA_QR_SSE2(a, b, c, d) do { \
+    b = _mm_xor_si128(b, SALSA_ROTL_SSE2(_mm_add_epi32(a, d), 7));  \
+    c = _mm_xor_si128(c, SALSA_ROTL_SSE2(_mm_add_epi32(b, a), 9));  \
+    d = _mm_xor_si128(d, SALSA_ROTL_SSE2(_mm_add_epi32(c, b), 13)); \
+    a = _mm_xor_si128(a, SALSA_ROTL_SSE2(_mm_add_epi32(d, c), 18)); \
+} while (0)
+
+#define SALSA_QR_AVX2(a, b, c, d) do { \
+    b = _mm256_xor_si256(b, SALSA_ROTL_AVX2(_mm256_add_epi32(a, d), 7));  \
+    c = _mm256_xor_si256(c, SALSA_ROTL_AVX2(_mm256_add_epi32(b, a), 9));  \
+    d = _mm256_xor_si256(d, SALSA_ROTL_AVX2(_mm256_add_epi32(c, b), 13)); \
+    a = _mm256_xor_si256(a, SALSA_ROTL_AVX2(_mm256_add_epi32(d, c), 18)); \
+} while (0)
+
+// Advance the 64-bit block counter (x8, x9) by n blocks
+static inline void salsa20_counter_add(uint32_t st[16], uint64_t n) {
+    uint64_t ctr = ((uint64_t)st[9] << 32) | st[8];
+    ctr += n;
+    st[8] = (uint32_t)ctr;
+    st[9] = (uint32_t)(ctr >> 32);
+}
+
+static inline int salsa20_have_avx2(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return cached;
+}
+
+// ---------------------------------------------------------------------------
+// SSE2 single block, diagonal layout
+// ---------------------------------------------------------------------------
+
+// Lane k of the result comes from wk
+static inline __m128i salsa_sse2_pick(__m128i w0, __m128i w1, __m128i w2, __m128i w3) {
+    const __m128i m0 = _mm_setr_epi32(-1, 0, 0, 0);
+    const __m128i m1 = _mm_setr_epi32(0, -1, 0, 0);
+    const __m128i m2 = _mm_setr_epi32(0, 0, -1, 0);
+    const __m128i m3 = _mm_setr_epi32(0, 0, 0, -1);
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(w0, m0), _mm_and_si128(w1, m1)),
+                        _mm_or_si128(_mm_and_si128(w2, m2), _mm_and_si128(w3, m3)));
+}
+
+// Rows (x0..x3), (x4..x7), ... -> diagonals a, b, c, d
+static inline void salsa20_sse2_to_diag(__m128i r[4]) {
+    __m128i a = salsa_sse2_pick(r[0], r[1], r[2], r[3]);
+    __m128i b = salsa_sse2_pick(r[1], r[2], r[3], r[0]);
+    __m128i c = salsa_sse2_pick(r[2], r[3], r[0], r[1]);
+    __m128i d = salsa_sse2_pick(r[3], r[0], r[1], r[2]);
+    r[0] = a; r[1] = b; r[2] = c; r[3] = d;
+}
+
+// Diagonals a, b, c, d -> rows
+static inline void salsa20_sse2_from_diag(__m128i v[4]) {
+    __m128i r0 = salsa_sse2_pick(v[0], v[3], v[2], v[1]);
+    __m128i r1 = salsa_sse2_pick(v[1], v[0], v[3], v[2]);
+    __m128i r2 = salsa_sse2_pick(v[2], v[1], v[0], v[3]);
+    __m128i r3 = salsa_sse2_pick(v[3], v[2], v[1], v[0]);
+    v[0] = r0; v[1] = r1; v[2] = r2; v[3] = r3;
+}
+
+// Salsa20/rounds permutation on a diagonal-layout state (no feed-forward)
+static inline void salsa20_sse2_diag_rounds(__m128i v[4], int rounds) {
+    __m128i a = v[0], b = v[1], c = v[2], d = v[3];
+    for (int i = 0; i < rounds; i += 2) {
+        // Column round
+        SALSA_QR_SSE2(a, b, c, d);
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3));
+        c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 3, 2));
+        d = _mm_shuffle_epi32(d, _MM_SHUFFLE(0, 3, 2, 1));
+        // Row round: same quarterround with b and d swapping roles
+        SALSA_QR_SSE2(a, d, c, b);
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1));
+        c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 3, 2));
+        d = _mm_shuffle_epi32(d, _MM_SHUFFLE(2, 1, 0, 3));
+    }
+    v[0] = a; v[1] = b; v[2] = c; v[3] = d;
+}
+
+// One 64-byte block: out = in ^ Salsa20(st)
+static inline void salsa20_xor_block_sse2(uint8_t *out, const uint8_t *in,
+                                          const uint32_t st[16], int rounds) {
+    __m128i v[4], s[4];
+    for (int i = 0; i < 4; ++i) v[i] = _mm_loadu_si128((const __m128i *)(st + 4*i));
+    salsa20_sse2_to_diag(v);
+    for (int i = 0; i < 4; ++i) s[i] = v[i];
+
+    salsa20_sse2_diag_rounds(v, rounds);
+
+    for (int i = 0; i < 4; ++i) v[i] = _mm_add_epi32(v[i], s[i]);
+    salsa20_sse2_from_diag(v);
+    for (int i = 0; i < 4; ++i) {
+        if (in) v[i] = _mm_xor_si128(v[i], _mm_loadu_si128((const __m128i *)(in + 16*i)));
+        _mm_storeu_si128((__m128i *)(out + 16*i), v[i]);
+    }
+}
+
+// Raw Salsa20/rounds permutation of st, no feed-forward (HSalsa20 core)
+static inline void salsa20_permute_sse2(uint8_t out[64], const uint32_t st[16], int rounds) {
+    __m128i v[4];
+    for (int i = 0; i < 4; ++i) v[i] = _mm_loadu_si128((const __m128i *)(st + 4*i));
+    salsa20_sse2_to_diag(v);
+    salsa20_sse2_diag_rounds(v, rounds);
+    salsa20_sse2_from_diag(v);
+    for (int i = 0; i < 4; ++i) _mm_storeu_si128((__m128i *)(out + 16*i), v[i]);
+}
+
+// ---------------------------------------------------------------------------
+// SSE2 four blocks, word-sliced
+// ---------------------------------------------------------------------------
+
+static inline void salsa20_xor_blocks4_sse2(uint8_t *out, const uint8_t *in,
+                                            const uint32_t st[16], int rounds) {
+    __m128i x[16], s[16];
+    uint64_t ctr = ((uint64_t)st[9] << 32) | st[8];
+
+    for (int i = 0; i < 16; ++i) s[i] = _mm_set1_epi32((int)st[i]);
+    s[8] = _mm_setr_epi32((int)(uint32_t)ctr, (int)(uint32_t)(ctr + 1),
+                          (int)(uint32_t)(ctr + 2), (int)(uint32_t)(ctr + 3));
+    s[9] = _mm_setr_epi32((int)(uint32_t)(ctr >> 32), (int)(uint32_t)((ctr + 1) >> 32),
+                          (int)(uint32_t)((ctr + 2) >> 32), (int)(uint32_t)((ctr + 3) >> 32));
+    for (int i = 0; i < 16; ++i) x[i] = s[i];
+
+    for (int i = 0; i < rounds; i += 2) {
+        SALSA_QR_SSE2(x[0], x[4], x[8], x[12]);
+        SALSA_QR_SSE2(x[5], x[9], x[13], x[1]);
+        SALSA_QR_SSE2(x[10], x[14], x[2], x[6]);
+        SALSA_QR_SSE2(x[15], x[3], x[7], x[11]);
+        SALSA_QR_SSE2(x[0], x[1], x[2], x[3]);
+        SALSA_QR_SSE2(x[5], x[6], x[7], x[4]);
+        SALSA_QR_SSE2(x[10], x[11], x[8], x[9]);
+        SALSA_QR_SSE2(x[15], x[12], x[13], x[14]);
+    }
+    for (int i = 0; i < 16; ++i) x[i] = _mm_add_epi32(x[i], s[i]);
+
+    // 4x4 transpose per group of four words, then store to each block
+    for (int g = 0; g < 4; ++g) {
+        __m128i t0 = _mm_unpacklo_epi32(x[4*g + 0], x[4*g + 1]);
+        __m128i t1 = _mm_unpacklo_epi32(x[4*g + 2], x[4*g + 3]);
+        __m128i t2 = _mm_unpackhi_epi32(x[4*g + 0], x[4*g + 1]);
+        __m128i t3 = _mm_unpackhi_epi32(x[4*g + 2], x[4*g + 3]);
+        __m128i blk[4];
+        blk[0] = _mm_unpacklo_epi64(t0, t1);
+        blk[1] = _mm_unpackhi_epi64(t0, t1);
+        blk[2] = _mm_unpacklo_epi64(t2, t3);
+        blk[3] = _mm_unpackhi_epi64(t2, t3);
+        for (int b = 0; b < 4; ++b) {
+            size_t off = 64*(size_t)b + 16*(size_t)g;
+            if (in) blk[b] = _mm_xor_si128(blk[b], _mm_loadu_si128((const __m128i *)(in + off)));
+            _mm_storeu_si128((__m128i *)(out + off), blk[b]);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 eight blocks, word-sliced
+// ---------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static inline void salsa20_xor_blocks8_avx2(uint8_t *out, const uint8_t *in,
+                                            const uint32_t st[16], int rounds) {
+    __m256i x[16], s[16];
+    uint64_t ctr = ((uint64_t)st[9] << 32) | st[8];
+    uint32_t lo[8], hi[8];
+
+    for (int k = 0; k < 8; ++k) {
+        lo[k] = (uint32_t)(ctr + (uint64_t)k);
+        hi[k] = (uint32_t)((ctr + (uint64_t)k) >> 32);
+    }
+    for (int i = 0; i < 16; ++i) s[i] = _mm256_set1_epi32((int)st[i]);
+    s[8] = _mm256_loadu_si256((const __m256i *)lo);
+    s[9] = _mm256_loadu_si256((const __m256i *)hi);
+    for (int i = 0; i < 16; ++i) x[i] = s[i];
+
+    for (int i = 0; i < rounds; i += 2) {
+        SALSA_QR_AVX2(x[0], x[4], x[8], x[12]);
+        SALSA_QR_AVX2(x[5], x[9], x[13], x[1]);
+        SALSA_QR_AVX2(x[10], x[14], x[2], x[6]);
+        SALSA_QR_AVX2(x[15], x[3], x[7], x[11]);
+        SALSA_QR_AVX2(x[0], x[1], x[2], x[3]);
+        SALSA_QR_AVX2(x[5], x[6], x[7], x[4]);
+        SALSA_QR_AVX2(x[10], x[11], x[8], x[9]);
+        SALSA_QR_AVX2(x[15], x[12], x[13], x[14]);
+    }
+    for (int i = 0; i < 16; ++i) x[i] = _mm256_add_epi32(x[i], s[i]);
+
+    // In-lane 4x4 transpose leaves block b in the low half and block b+4 in
+    // the high half of blk[b]
+    for (int g = 0; g < 4; ++g) {
+        __m256i t0 = _mm256_unpacklo_epi32(x[4*g + 0], x[4*g + 1]);
+        __m256i t1 = _mm256_unpacklo_epi32(x[4*g + 2], x[4*g + 3]);
+        __m256i t2 = _mm256_unpackhi_epi32(x[4*g + 0], x[4*g + 1]);
+        __m256i t3 = _mm256_unpackhi_epi32(x[4*g + 2], x[4*g + 3]);
+        __m256i blk[4];
+        blk[0] = _mm256_unpacklo_epi64(t0, t1);
+        blk[1] = _mm256_unpackhi_epi64(t0, t1);
+        blk[2] = _mm256_unpacklo_epi64(t2, t3);
+        blk[3] = _mm256_unpackhi_epi64(t2, t3);
+        for (int b = 0; b < 4; ++b) {
+            __m128i lo128 = _mm256_castsi256_si128(blk[b]);
+            __m128i hi128 = _mm256_extracti128_si256(blk[b], 1);
+            size_t off_lo = 64*(size_t)b + 16*(size_t)g;
+            size_t off_hi = 64*(size_t)(b + 4) + 16*(size_t)g;
+            if (in) {
+                lo128 = _mm_xor_si128(lo128, _mm_loadu_si128((const __m128i *)(in + off_lo)));
+                hi128 = _mm_xor_si128(hi128, _mm_loadu_si128((const __m128i *)(in + off_hi)));
+            }
+            _mm_storeu_si128((__m128i *)(out + off_lo), lo128);
+            _mm_storeu_si128((__m128i *)(out + off_hi), hi128);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 eight independent states, one per lane
+// ---------------------------------------------------------------------------
+
+// 8x8 transpose of 32-bit words: row k of r[] becomes lane k of every vector
+__attribute__((target("avx2")))
+static inline void salsa_avx2_transpose8(__m256i r[8]) {
+    __m256i t[8], u[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i]     = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        u[i]     = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for (int i = 0; i < 4; ++i) {
+        r[i]     = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        r[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+// One block from each of eight unrelated states (different keys, nonces or
+// counters), e.g. the first block of eight different secretboxes.  Lane k
+// writes 64 bytes to out[k]; feed_forward == 0 stores the raw permutation
+// (HSalsa20) instead of the keystream.
+__attribute__((target("avx2")))
+static inline void salsa20_blocks8_lanes_avx2(uint8_t *const out[8], const uint32_t *const st[8],
+                                              int rounds, int feed_forward) {
+    __m256i x[16], s[16];
+
+    for (int half = 0; half < 2; ++half) {
+        for (int k = 0; k < 8; ++k)
+            s[8*half + k] = _mm256_loadu_si256((const __m256i *)(st[k] + 8*half));
+        salsa_avx2_transpose8(s + 8*half);
+    }
+    for (int i = 0; i < 16; ++i) x[i] = s[i];
+
+    for (int i = 0; i < rounds; i += 2) {
+        SALSA_QR_AVX2(x[0], x[4], x[8], x[12]);
+        SALSA_QR_AVX2(x[5], x[9], x[13], x[1]);
+        SALSA_QR_AVX2(x[10], x[14], x[2], x[6]);
+        SALSA_QR_AVX2(x[15], x[3], x[7], x[11]);
+        SALSA_QR_AVX2(x[0], x[1], x[2], x[3]);
+        SALSA_QR_AVX2(x[5], x[6], x[7], x[4]);
+        SALSA_QR_AVX2(x[10], x[11], x[8], x[9]);
+        SALSA_QR_AVX2(x[15], x[12], x[13], x[14]);
+    }
+    if (feed_forward)
+        for (int i = 0; i < 16; ++i) x[i] = _mm256_add_epi32(x[i], s[i]);
+
+    for (int half = 0; half < 2; ++half) {
+        salsa_avx2_transpose8(x + 8*half);
+        for (int k = 0; k < 8; ++k)
+            _mm256_storeu_si256((__m256i *)(out[k] + 32*half), x[8*half + k]);
+    }
+}
+
+#endif // SALSA20_SIMD_H
@@ -1,9 +1,14 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <x86intrin.h>  // For __rdtsc()
+#include "keystream.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+#include "bench_hist.h"
+#include "bench_perf.h"
 
 // Salsa20 parameters
 #define SALSA_ROUNDS 20  // Standard = 20 rounds
@@ -79,14 +84,15 @@ void salsa20_init(salsa20_state_t *st, const uint8_t key[32], const uint8_t nonc
         st->input[11 + i] = u8to32(key + 16 + 4*i);
     }
 
-    // Counter (64-bit) + Nonce (64-bit)
-    st->input[6] = (uint32_t)(counter & 0xffffffffu);
-    st->input[7] = (uint32_t)(counter >> 32);
-    st->input[8] = u8to32(nonce + 0);
-    st->input[9] = u8to32(nonce + 4);
+    // Nonce (64-bit) + Counter (64-bit), standard Salsa20 word positions
+    st->input[6] = u8to32(nonce + 0);
+    st->input[7] = u8to32(nonce + 4);
+    st->input[8] = (uint32_t)(counter & 0xffffffffu);
+    st->input[9] = (uint32_t)(counter >> 32);
 }
 
-void salsa20_encrypt_buffer(salsa20_state_t *st, uint8_t *data, size_t len) {
+// Scalar reference path (also used for the final partial block)
+void salsa20_encrypt_buffer_scalar(salsa20_state_t *st, uint8_t *data, size_t len) {
     uint8_t keystream[64];
     size_t pos = 0;
     while (pos < len) {
@@ -98,10 +104,61 @@ void salsa20_encrypt_buffer(salsa20_state_t *st, uint8_t *data, size_t len) {
         pos += take;
 
         // increment 64-bit block counter
-        if (++st->input[6] == 0) {
-            st->input[7]++;
+        if (++st->input[8] == 0) {
+            st->input[9]++;
+        }
+    }
+}
+
+typedef enum {
+    SALSA_IMPL_SCALAR = 0,  // salsa20_block, one block at a time
+    SALSA_IMPL_SSE2,        // diagonal layout, one block at a time
+    SALSA_IMPL_SSE2_X4,     // word-sliced, 4 blocks per call
+    SALSA_IMPL_AVX2_X8,     // word-sliced, 8 blocks per call
+    SALSA_IMPL_COUNT
+} salsa20_impl_t;
+
+static const char *salsa_impl_names[SALSA_IMPL_COUNT] = {
+    "scalar", "SSE2 1-block", "SSE2 4-block", "AVX2 8-block"
+};
+
+// Widest kernel first, then narrower ones, scalar only for the last partial block
+void salsa20_encrypt_buffer_impl(salsa20_state_t *st, uint8_t *data, size_t len, salsa20_impl_t impl) {
+    size_t pos = 0;
+
+    if (impl == SALSA_IMPL_SCALAR) {
+        salsa20_encrypt_buffer_scalar(st, data, len);
+        return;
+    }
+    if (impl >= SALSA_IMPL_AVX2_X8) {
+        for (; len - pos >= 512; pos += 512) {
+            salsa20_xor_blocks8_avx2(data + pos, data + pos, st->input, SALSA_ROUNDS);
+            salsa20_counter_add(st->input, 8);
         }
     }
+    if (impl >= SALSA_IMPL_SSE2_X4) {
+        for (; len - pos >= 256; pos += 256) {
+            salsa20_xor_blocks4_sse2(data + pos, data + pos, st->input, SALSA_ROUNDS);
+            salsa20_counter_add(st->input, 4);
+        }
+    }
+    for (; len - pos >= 64; pos += 64) {
+        salsa20_xor_block_sse2(data + pos, data + pos, st->input, SALSA_ROUNDS);
+        salsa20_counter_add(st->input, 1);
+    }
+    if (pos < len) {
+        uint8_t keystream[64] __attribute__((aligned(KEYSTREAM_ALIGN)));
+        salsa20_keystream(keystream, st->input, 1, SALSA_ROUNDS);
+        keystream_xor(data + pos, data + pos, keystream, len - pos);
+    }
+}
+
+static salsa20_impl_t salsa20_best_impl(void) {
+    return salsa20_have_avx2() ? SALSA_IMPL_AVX2_X8 : SALSA_IMPL_SSE2_X4;
+}
+
+void salsa20_encrypt_buffer(salsa20_state_t *st, uint8_t *data, size_t len) {
+    salsa20_encrypt_buffer_impl(st, data, len, salsa20_best_impl());
 }
 
 // Simple LCG PRNG for benchmarking
@@ -114,7 +171,42 @@ void generate_random(uint8_t *buf, size_t len) {
     for (size_t i = 0; i < len; ++i) buf[i] = (uint8_t)(lcg_rand() & 0xffu);
 }
 
-int main() {
+// Every kernel must reproduce the scalar keystream, including odd lengths
+// that exercise the tail handler and a counter that carries into word 9
+static int salsa20_self_check(void) {
+    static const size_t lens[] = { 1, 63, 64, 65, 255, 256, 511, 512, 1000, 4099 };
+    uint8_t key[32], nonce[8];
+    uint8_t ref[4099], buf[4099];
+    int ok = 1;
+
+    generate_random(key, sizeof(key));
+    generate_random(nonce, sizeof(nonce));
+    for (int impl = SALSA_IMPL_SSE2; impl < SALSA_IMPL_COUNT; ++impl) {
+        if (impl == SALSA_IMPL_AVX2_X8 && !salsa20_have_avx2()) continue;
+        for (size_t t = 0; t < sizeof(lens) / sizeof(lens[0]); ++t) {
+            salsa20_state_t a, b;
+            generate_random(ref, lens[t]);
+            memcpy(buf, ref, lens[t]);
+            salsa20_init(&a, key, nonce, 0xfffffffcull);
+            salsa20_init(&b, key, nonce, 0xfffffffcull);
+            salsa20_encrypt_buffer_scalar(&a, ref, lens[t]);
+            salsa20_encrypt_buffer_impl(&b, buf, lens[t], (salsa20_impl_t)impl);
+            if (memcmp(ref, buf, lens[t]) != 0 || memcmp(a.input, b.input, sizeof(a.input)) != 0) {
+                printf("Self-check FAILED: %s, len %zu\n", salsa_impl_names[impl], lens[t]);
+                ok = 0;
+            }
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    bench_isolate(0);
+    bench_timing_init();
+
+    bench_perf_t perf;
+    bench_perf_open(&perf);
+
     salsa20_state_t state;
     size_t data_len = 1024 * 1024; // 1 MB
     uint8_t *data = malloc(data_len);
@@ -125,25 +217,60 @@ int main() {
         perror("Failed to allocate memory");
         return 1;
     }
+    bench_prefault(data, data_len);
 
-    const int runs = 10000;
-    uint64_t total_cycles = 0;
+    // optional arg: [runs]
+    int runs = 10000;
+    if (argc >= 2) runs = atoi(argv[1]);
+    if (runs < 1) runs = 1;
 
-    for (int i = 0; i < runs; ++i) {
-        generate_random(data, data_len);       // plaintext
-        generate_random(key, sizeof(key));    // key
-        generate_random(nonce, sizeof(nonce));// nonce
+    if (!salsa20_self_check()) {
+        free(data);
+        return 1;
+    }
+    printf("Kernel self-check against scalar: OK\n");
 
-        salsa20_init(&state, key, nonce, 0ull);
+    double cpb[SALSA_IMPL_COUNT] = {0};
 
-        uint64_t start = __rdtsc();
-        salsa20_encrypt_buffer(&state, data, data_len);
-        uint64_t end = __rdtsc();
+    for (int impl = 0; impl < SALSA_IMPL_COUNT; ++impl) {
+        if (impl == SALSA_IMPL_AVX2_X8 && !salsa20_have_avx2()) {
+            printf("%-13s: skipped (no AVX2)\n", salsa_impl_names[impl]);
+            continue;
+        }
+        uint64_t total_cycles = 0;
+        bench_hist_t hist;
+        bench_hist_init(&hist);
+        bench_perf_reset(&perf);
 
-        total_cycles += (end - start);
-    }
+        for (int i = 0; i < runs; ++i) {
+            generate_random(data, data_len);       // plaintext
+            generate_random(key, sizeof(key));    // key
+            generate_random(nonce, sizeof(nonce));// nonce
+
+            salsa20_init(&state, key, nonce, 0ull);
 
-    double avg_cycles = (double)total_cycles / runs;
+            bench_perf_start(&perf);
+            uint64_t start = bench_tsc_start();
+            salsa20_encrypt_buffer_impl(&state, data, data_len, (salsa20_impl_t)impl);
+            uint64_t end = bench_tsc_stop();
+            bench_perf_stop(&perf);
+
+            uint64_t cycles = bench_elapsed(start, end);
+            total_cycles += cycles;
+            bench_hist_record(&hist, cycles);
+        }
+
+        double avg_cycles = (double)total_cycles / runs;
+        cpb[impl] = avg_cycles / data_len;
+        printf("%-13s: avg cycles %.2f, cycles per byte %.2f, speedup vs scalar %.2fx\n",
+               salsa_impl_names[impl], avg_cycles, cpb[impl],
+               impl == SALSA_IMPL_SCALAR ? 1.0 : cpb[SALSA_IMPL_SCALAR] / cpb[impl]);
+        char label[48];
+        snprintf(label, sizeof(label), "%-13s  cycles per byte", salsa_impl_names[impl]);
+        bench_hist_print(&hist, label, (double)data_len);
+        snprintf(label, sizeof(label), "%-13s  counters per byte", salsa_impl_names[impl]);
+        bench_perf_print(&perf, label, (double)data_len * runs);
+    }
 
     printf("Sample encrypted output (first 16 bytes): ");
     for (int i = 0; i < 16; ++i) {
@@ -153,8 +280,9 @@ int main() {
 
     printf("Data size: %zu bytes\n", data_len);
     printf("Total runs: %d\n", runs);
-    printf("Average cycles (Salsa20 only): %.2f\n", avg_cycles);
-    printf("Average cycles per byte: %.2f\n", avg_cycles / data_len);
+    printf("Dispatched kernel: %s\n", salsa_impl_names[salsa20_best_impl()]);
+    printf("Average cycles per byte (Salsa20 only): %.2f\n", cpb[salsa20_best_impl()]);
+    printf("Average ns per byte (Salsa20 only): %.3f (TSC %.3f GHz)\n", bench_ns(cpb[salsa20_best_impl()]), bench_tsc_ghz);
 
     free(data);
     return 0;
@@ -0,0 +1,320 @@
+// scrypt.c
+// scrypt(N, r, p) password-based KDF (RFC 7914)
+//
+// - BlockMix / ROMix on the Salsa20/8 core, using the SSE2 diagonal-layout
+//   kernel from salsa20_simd.h.  Blocks stay in the diagonal layout for the
+//   whole of ROMix and are converted only on entry and exit.
+// - Each worker thread owns an arena for V (128*r*N bytes) plus the BlockMix
+//   scratch.  It is mapped once, backed by huge pages when possible, and
+//   reused by later derivations of the same or smaller size.
+// - The p independent lanes run on separate threads.
+//
+// Compile: gcc -O2 -pthread scrypt.c -o scrypt
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "salsa20_simd.h"
+#include "sha256.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+
+#define SCRYPT_ROUNDS       8            // Salsa20/8
+#define SCRYPT_MAX_THREADS  64
+#define HUGE_PAGE_SIZE      (2u << 20)   // 2 MB
+
+typedef struct {
+    void *mem;
+    size_t size;
+    int huge;          // 1 = MAP_HUGETLB, 0 = regular pages (THP advised)
+} scrypt_arena_t;
+
+typedef struct {
+    int nthreads;
+    scrypt_arena_t arena[SCRYPT_MAX_THREADS];
+} scrypt_ctx_t;
+
+// ---------------------------------------------------------------------------
+// Huge-page arena
+// ---------------------------------------------------------------------------
+
+static void scrypt_arena_release(scrypt_arena_t *a) {
+    if (a->mem) munmap(a->mem, a->size);
+    a->mem = NULL;
+    a->size = 0;
+    a->huge = 0;
+}
+
+// Make sure the arena holds at least size bytes; only remaps when it grows
+static int scrypt_arena_reserve(scrypt_arena_t *a, size_t size) {
+    if (a->size >= size) return 0;
+    scrypt_arena_release(a);
+
+    size = (size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        a->huge = 1;
+    } else {
+        // No reserved hugetlbfs pages: fall back to transparent huge pages
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return -1;
+        madvise(p, size, MADV_HUGEPAGE);
+        a->huge = 0;
+    }
+    a->mem = p;
+    a->size = size;
+    return 0;
+}
+
+int scrypt_ctx_init(scrypt_ctx_t *ctx, int nthreads) {
+    memset(ctx, 0, sizeof(*ctx));
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > SCRYPT_MAX_THREADS) nthreads = SCRYPT_MAX_THREADS;
+    ctx->nthreads = nthreads;
+    return 0;
+}
+
+void scrypt_ctx_free(scrypt_ctx_t *ctx) {
+    for (int t = 0; t < SCRYPT_MAX_THREADS; ++t) scrypt_arena_release(&ctx->arena[t]);
+}
+
+// ---------------------------------------------------------------------------
+// BlockMix / ROMix in the diagonal layout
+// ---------------------------------------------------------------------------
+
+// Y = BlockMix_salsa20/8(B ^ V); V may be NULL.  B, V and Y hold 2r
+// 64-byte blocks of four diagonal vectors each.
+static void scrypt_blockmix(__m128i *Y, const __m128i *B, const __m128i *V, uint32_t r) {
+    __m128i x[4], t[4];
+    const size_t last = 4 * (2 * (size_t)r - 1);
+
+    for (int k = 0; k < 4; ++k)
+        x[k] = V ? _mm_xor_si128(B[last + k], V[last + k]) : B[last + k];
+
+    for (size_t i = 0; i < 2 * (size_t)r; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            __m128i b = V ? _mm_xor_si128(B[4*i + k], V[4*i + k]) : B[4*i + k];
+            x[k] = _mm_xor_si128(x[k], b);
+            t[k] = x[k];
+        }
+        salsa20_sse2_diag_rounds(x, SCRYPT_ROUNDS);
+        for (int k = 0; k < 4; ++k) x[k] = _mm_add_epi32(x[k], t[k]);
+
+        // Even blocks to the first half of Y, odd blocks to the second
+        __m128i *dst = Y + 4 * ((i / 2) + (i & 1) * (size_t)r);
+        for (int k = 0; k < 4; ++k) dst[k] = x[k];
+    }
+}
+
+// Integerify: first 64 bits of the last block.  x0 is lane 0 of diagonal a,
+// x1 is lane 1 of diagonal d.
+static uint64_t scrypt_integerify(const __m128i *X, uint32_t r) {
+    const __m128i *last = X + 4 * (2 * (size_t)r - 1);
+    uint32_t lo = (uint32_t)_mm_cvtsi128_si32(last[0]);
+    uint32_t hi = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(last[3], _MM_SHUFFLE(1, 1, 1, 1)));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// B (128*r bytes, little-endian words) = ROMix(B); mem holds V then X, Y
+static void scrypt_romix(uint8_t *B, uint64_t N, uint32_t r, void *mem) {
+    const size_t vecs = 8 * (size_t)r;  // __m128i per 128r-byte block
+    __m128i *V = (__m128i *)mem;
+    __m128i *X = V + vecs * N;
+    __m128i *Y = X + vecs;
+
+    for (size_t i = 0; i < 2 * (size_t)r; ++i) {
+        for (int k = 0; k < 4; ++k) X[4*i + k] = _mm_loadu_si128((const __m128i *)(B + 64*i + 16*k));
+        salsa20_sse2_to_diag(X + 4*i);
+    }
+
+    for (uint64_t i = 0; i < N; ++i) {
+        memcpy(V + vecs * i, X, vecs * sizeof(__m128i));
+        scrypt_blockmix(Y, X, NULL, r);
+        __m128i *tmp = X; X = Y; Y = tmp;
+    }
+    for (uint64_t i = 0; i < N; ++i) {
+        uint64_t j = scrypt_integerify(X, r) & (N - 1);
+        scrypt_blockmix(Y, X, V + vecs * j, r);
+        __m128i *tmp = X; X = Y; Y = tmp;
+    }
+
+    for (size_t i = 0; i < 2 * (size_t)r; ++i) {
+        salsa20_sse2_from_diag(X + 4*i);
+        for (int k = 0; k < 4; ++k) _mm_storeu_si128((__m128i *)(B + 64*i + 16*k), X[4*i + k]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Lane threads
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t *B;
+    uint64_t N;
+    uint32_t r, p;
+    int tid, nthreads;
+    scrypt_arena_t *arena;
+} scrypt_job_t;
+
+static void *scrypt_worker(void *arg) {
+    scrypt_job_t *job = (scrypt_job_t *)arg;
+    for (uint32_t lane = (uint32_t)job->tid; lane < job->p; lane += (uint32_t)job->nthreads)
+        scrypt_romix(job->B + (size_t)lane * 128 * job->r, job->N, job->r, job->arena->mem);
+    return NULL;
+}
+
+// Returns 0 on success, -1 on bad parameters or allocation failure
+int scrypt(scrypt_ctx_t *ctx, const uint8_t *pass, size_t passlen, const uint8_t *salt, size_t saltlen,
+           uint64_t N, uint32_t r, uint32_t p, uint8_t *out, size_t outlen) {
+    if (N < 2 || (N & (N - 1)) != 0 || r == 0 || p == 0) return -1;
+    if ((uint64_t)r * p >= (1u << 30)) return -1;
+    if (N > (SIZE_MAX / 128 / r) - 2) return -1;
+
+    const size_t blen = (size_t)128 * r * p;
+    const size_t need = (size_t)128 * r * (N + 2);  // V, X, Y
+    int nthreads = ctx->nthreads < (int)p ? ctx->nthreads : (int)p;
+
+    uint8_t *B = malloc(blen);
+    if (!B) return -1;
+    for (int t = 0; t < nthreads; ++t) {
+        if (scrypt_arena_reserve(&ctx->arena[t], need) != 0) {
+            free(B);
+            return -1;
+        }
+    }
+
+    pbkdf2_hmac_sha256(pass, passlen, salt, saltlen, 1, B, blen);
+
+    scrypt_job_t jobs[SCRYPT_MAX_THREADS];
+    pthread_t th[SCRYPT_MAX_THREADS];
+    for (int t = 0; t < nthreads; ++t)
+        jobs[t] = (scrypt_job_t){ B, N, r, p, t, nthreads, &ctx->arena[t] };
+    // Thread 0's lanes run on the calling thread
+    int spawned = 1;
+    for (int t = 1; t < nthreads; ++t, ++spawned) {
+        if (pthread_create(&th[t], NULL, scrypt_worker, &jobs[t]) != 0) break;
+    }
+    if (spawned < nthreads) {
+        // Could not start every thread: the caller picks up their lanes
+        for (int t = spawned; t < nthreads; ++t) scrypt_worker(&jobs[t]);
+    }
+    scrypt_worker(&jobs[0]);
+    for (int t = 1; t < spawned; ++t) pthread_join(th[t], NULL);
+
+    pbkdf2_hmac_sha256(pass, passlen, B, blen, 1, out, outlen);
+    memset(B, 0, blen);
+    free(B);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Self-check and benchmark
+// ---------------------------------------------------------------------------
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// RFC 7914 section 12, vectors 1 and 2
+static int scrypt_self_check(scrypt_ctx_t *ctx) {
+    static const uint8_t v1[64] = {
+        0x77,0xd6,0x57,0x62,0x38,0x65,0x7b,0x20,0x3b,0x19,0xca,0x42,0xc1,0x8a,0x04,0x97,
+        0xf1,0x6b,0x48,0x44,0xe3,0x07,0x4a,0xe8,0xdf,0xdf,0xfa,0x3f,0xed,0xe2,0x14,0x42,
+        0xfc,0xd0,0x06,0x9d,0xed,0x09,0x48,0xf8,0x32,0x6a,0x75,0x3a,0x0f,0xc8,0x1f,0x17,
+        0xe8,0xd3,0xe0,0xfb,0x2e,0x0d,0x36,0x28,0xcf,0x35,0xe2,0x0c,0x38,0xd1,0x89,0x06
+    };
+    static const uint8_t v2[64] = {
+        0xfd,0xba,0xbe,0x1c,0x9d,0x34,0x72,0x00,0x78,0x56,0xe7,0x19,0x0d,0x01,0xe9,0xfe,
+        0x7c,0x6a,0xd7,0xcb,0xc8,0x23,0x78,0x30,0xe7,0x73,0x76,0x63,0x4b,0x37,0x31,0x62,
+        0x2e,0xaf,0x30,0xd9,0x2e,0x22,0xa3,0x88,0x6f,0xf1,0x09,0x27,0x9d,0x98,0x30,0xda,
+        0xc7,0x27,0xaf,0xb9,0x4a,0x83,0xee,0x6d,0x83,0x60,0xcb,0xdf,0xa2,0xcc,0x06,0x40
+    };
+    uint8_t dk[64];
+
+    if (scrypt(ctx, (const uint8_t *)"", 0, (const uint8_t *)"", 0, 16, 1, 1, dk, 64) != 0 ||
+        memcmp(dk, v1, 64) != 0) {
+        printf("Self-check FAILED: RFC 7914 vector 1\n");
+        return 0;
+    }
+    if (scrypt(ctx, (const uint8_t *)"password", 8, (const uint8_t *)"NaCl", 4, 1024, 8, 16, dk, 64) != 0 ||
+        memcmp(dk, v2, 64) != 0) {
+        printf("Self-check FAILED: RFC 7914 vector 2\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    bench_isolate(BENCH_ALL_CPUS);
+    bench_timing_init();
+
+    // Standard parameter sets: RFC 7914 vector 2, interactive login
+    // (Percival 2009), and a 4-lane variant; "full" adds N = 2^20
+    struct { uint64_t N; uint32_t r, p; } sets[] = {
+        { 1024, 8, 16 }, { 16384, 8, 1 }, { 16384, 8, 4 }, { 1048576, 8, 1 }
+    };
+    int nsets = (argc >= 2 && strcmp(argv[1], "full") == 0) ? 4 : 3;
+    const int runs = 5;
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    scrypt_ctx_t ctx;
+    scrypt_ctx_init(&ctx, ncpu > 0 ? (int)ncpu : 1);
+
+    if (!scrypt_self_check(&ctx)) {
+        scrypt_ctx_free(&ctx);
+        return 1;
+    }
+    printf("Self-check (RFC 7914 vectors 1, 2): OK\n");
+    printf("Worker threads: up to %d\n\n", ctx.nthreads);
+
+    printf("%8s %3s %3s %12s %12s %16s %12s %10s\n",
+           "N", "r", "p", "min ms", "avg ms", "avg Mcycles", "arena MB", "huge");
+    for (int s = 0; s < nsets; ++s) {
+        uint8_t dk[64];
+        double best = 1e30, sum = 0;
+        uint64_t cyc = 0;
+
+        for (int i = 0; i < runs; ++i) {
+            double t0 = now_sec();
+            uint64_t c0 = bench_tsc_start();
+            if (scrypt(&ctx, (const uint8_t *)"pleaseletmein", 13, (const uint8_t *)"SodiumChloride", 14,
+                       sets[s].N, sets[s].r, sets[s].p, dk, sizeof(dk)) != 0) {
+                printf("scrypt(N=%llu, r=%u, p=%u) failed\n",
+                       (unsigned long long)sets[s].N, sets[s].r, sets[s].p);
+                scrypt_ctx_free(&ctx);
+                return 1;
+            }
+            uint64_t c1 = bench_tsc_stop();
+            double ms = (now_sec() - t0) * 1e3;
+            if (ms < best) best = ms;
+            sum += ms;
+            cyc += bench_elapsed(c0, c1);
+        }
+
+        size_t arena_bytes = 0;
+        int threads = ctx.nthreads < (int)sets[s].p ? ctx.nthreads : (int)sets[s].p;
+        for (int t = 0; t < threads; ++t) arena_bytes += ctx.arena[t].size;
+        printf("%8llu %3u %3u %12.2f %12.2f %16.2f %12.1f %10s\n",
+               (unsigned long long)sets[s].N, sets[s].r, sets[s].p, best, sum / runs,
+               (double)cyc / runs / 1e6, (double)arena_bytes / (1 << 20),
+               ctx.arena[0].huge ? "hugetlb" : "thp");
+    }
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("\nPeak resident memory: %.1f MB\n", (double)ru.ru_maxrss / 1024.0);
+
+    scrypt_ctx_free(&ctx);
+    return 0;
+}
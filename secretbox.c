@@ -0,0 +1,557 @@
+// secretbox.c
+// XSalsa20-Poly1305 secretbox, wire compatible with NaCl / libsodium
+// crypto_secretbox_easy: box = tag (16 bytes) || ciphertext.
+//
+// - HSalsa20: Salsa20 core without feed-forward, derives a per-nonce subkey
+// - XSalsa20: Salsa20 under the HSalsa20 subkey with the last 8 nonce bytes
+// - Poly1305: one-time MAC keyed by the first 32 keystream bytes
+// - Batched seal / open: many small boxes per call, each with its own nonce.
+//   The per-box single blocks (HSalsa20, keystream block 0, last partial
+//   block) of eight boxes run together in the AVX2 lanes kernel; whole
+//   middle blocks use the same-key multi-block kernels.
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "keystream.h"
+#include "bench_env.h"
+#include "bench_timing.h"
+
+#define SALSA_ROUNDS 20
+
+#define SECRETBOX_KEYBYTES   32
+#define SECRETBOX_NONCEBYTES 24
+#define SECRETBOX_MACBYTES   16
+#define SECRETBOX_LANES      8   // boxes per lanes-kernel call
+
+typedef struct {
+    const uint8_t *nonce;  // 24 bytes, unique per box under one key
+    const uint8_t *in;     // seal: plaintext, open: tag || ciphertext
+    uint8_t *out;          // seal: tag || ciphertext, open: plaintext
+    size_t mlen;           // plaintext length (box is mlen + 16 bytes)
+} secretbox_item_t;
+
+// "expand 32-byte k"
+static const uint32_t salsa_constants[4] = {
+    0x61707865u, 0x3320646eu, 0x79622d32u, 0x6b206574u
+};
+
+static uint32_t u8to32(const uint8_t *p) {
+    return ((uint32_t)p[0]) | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t u8to64(const uint8_t *p) {
+    return (uint64_t)u8to32(p) | ((uint64_t)u8to32(p + 4) << 32);
+}
+
+static void u64to8(uint64_t v, uint8_t *p) {
+    for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8*i));
+}
+
+// ---------------------------------------------------------------------------
+// Poly1305 (44/44/42-bit limbs, 128-bit products)
+// ---------------------------------------------------------------------------
+
+#define POLY_MASK44 0xfffffffffffULL
+#define POLY_MASK42 0x3ffffffffffULL
+
+typedef struct {
+    uint64_t r[3];
+    uint64_t h[3];
+    uint64_t pad[2];
+} poly1305_state_t;
+
+static void poly1305_init(poly1305_state_t *st, const uint8_t key[32]) {
+    uint64_t t0 = u8to64(key + 0);
+    uint64_t t1 = u8to64(key + 8);
+
+    // r is clamped as the spec requires
+    st->r[0] = t0 & 0xffc0fffffffULL;
+    st->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+    st->r[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+    st->h[0] = st->h[1] = st->h[2] = 0;
+    st->pad[0] = u8to64(key + 16);
+    st->pad[1] = u8to64(key + 24);
+}
+
+// Absorb full 16-byte blocks; hibit is 2^128 for full blocks, 0 for the
+// padded last block
+static void poly1305_blocks(poly1305_state_t *st, const uint8_t *m, size_t len, uint64_t hibit) {
+    const uint64_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2];
+    const uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    uint64_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2];
+
+    while (len >= 16) {
+        uint64_t t0 = u8to64(m), t1 = u8to64(m + 8);
+        h0 += t0 & POLY_MASK44;
+        h1 += ((t0 >> 44) | (t1 << 20)) & POLY_MASK44;
+        h2 += (((t1 >> 24)) & POLY_MASK42) | hibit;
+
+        unsigned __int128 d0 = (unsigned __int128)h0 * r0 + (unsigned __int128)h1 * s2 + (unsigned __int128)h2 * s1;
+        unsigned __int128 d1 = (unsigned __int128)h0 * r1 + (unsigned __int128)h1 * r0 + (unsigned __int128)h2 * s2;
+        unsigned __int128 d2 = (unsigned __int128)h0 * r2 + (unsigned __int128)h1 * r1 + (unsigned __int128)h2 * r0;
+
+        uint64_t c = (uint64_t)(d0 >> 44); h0 = (uint64_t)d0 & POLY_MASK44;
+        d1 += c; c = (uint64_t)(d1 >> 44); h1 = (uint64_t)d1 & POLY_MASK44;
+        d2 += c; c = (uint64_t)(d2 >> 42); h2 = (uint64_t)d2 & POLY_MASK42;
+        h0 += c * 5; c = h0 >> 44; h0 &= POLY_MASK44;
+        h1 += c;
+
+        m += 16;
+        len -= 16;
+    }
+    st->h[0] = h0; st->h[1] = h1; st->h[2] = h2;
+}
+
+static void poly1305_finish(poly1305_state_t *st, uint8_t mac[16]) {
+    uint64_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2];
+    uint64_t c, g0, g1, g2;
+
+    // Fully carry h
+    c = h1 >> 44; h1 &= POLY_MASK44;
+    h2 += c; c = h2 >> 42; h2 &= POLY_MASK42;
+    h0 += c * 5; c = h0 >> 44; h0 &= POLY_MASK44;
+    h1 += c; c = h1 >> 44; h1 &= POLY_MASK44;
+    h2 += c; c = h2 >> 42; h2 &= POLY_MASK42;
+    h0 += c * 5; c = h0 >> 44; h0 &= POLY_MASK44;
+    h1 += c;
+
+    // g = h - (2^130 - 5); keep g if it did not underflow (constant time)
+    g0 = h0 + 5; c = g0 >> 44; g0 &= POLY_MASK44;
+    g1 = h1 + c; c = g1 >> 44; g1 &= POLY_MASK44;
+    g2 = h2 + c - (1ULL << 42);
+    c = (g2 >> 63) - 1;
+    g0 &= c; g1 &= c; g2 &= c;
+    c = ~c;
+    h0 = (h0 & c) | g0; h1 = (h1 & c) | g1; h2 = (h2 & c) | g2;
+
+    // mac = (h + pad) mod 2^128
+    uint64_t t0 = st->pad[0], t1 = st->pad[1];
+    h0 += t0 & POLY_MASK44; c = h0 >> 44; h0 &= POLY_MASK44;
+    h1 += (((t0 >> 44) | (t1 << 20)) & POLY_MASK44) + c; c = h1 >> 44; h1 &= POLY_MASK44;
+    h2 += ((t1 >> 24) & POLY_MASK42) + c; h2 &= POLY_MASK42;
+
+    u64to8(h0 | (h1 << 44), mac);
+    u64to8((h1 >> 20) | (h2 << 24), mac + 8);
+}
+
+void poly1305(uint8_t mac[16], const uint8_t *m, size_t len, const uint8_t key[32]) {
+    poly1305_state_t st;
+    size_t full = len & ~(size_t)15;
+
+    poly1305_init(&st, key);
+    poly1305_blocks(&st, m, full, 1ULL << 40);
+    if (len > full) {
+        uint8_t last[16] = {0};
+        memcpy(last, m + full, len - full);
+        last[len - full] = 1;
+        poly1305_blocks(&st, last, 16, 0);
+    }
+    poly1305_finish(&st, mac);
+}
+
+// Constant-time tag comparison
+static int poly1305_verify(const uint8_t a[16], const uint8_t b[16]) {
+    uint8_t d = 0;
+    for (int i = 0; i < 16; ++i) d |= a[i] ^ b[i];
+    return d == 0;
+}
+
+// ---------------------------------------------------------------------------
+// HSalsa20 / XSalsa20
+// ---------------------------------------------------------------------------
+
+// HSalsa20 input: key in the key words, 16 nonce bytes in words 6..9
+static void hsalsa20_setup(uint32_t st[16], const uint8_t key[32], const uint8_t nonce[16]) {
+    st[0] = salsa_constants[0];
+    st[5] = salsa_constants[1];
+    st[10] = salsa_constants[2];
+    st[15] = salsa_constants[3];
+    for (int i = 0; i < 4; ++i) {
+        st[1 + i] = u8to32(key + 4*i);
+        st[11 + i] = u8to32(key + 16 + 4*i);
+        st[6 + i] = u8to32(nonce + 4*i);
+    }
+}
+
+// XSalsa20 state from the HSalsa20 output (words 0,5,10,15,6,7,8,9 are the
+// subkey) and the last 8 nonce bytes
+static void xsalsa20_setup(uint32_t st[16], const uint8_t hout[64], const uint8_t nonce[24], uint64_t counter) {
+    static const int subkey_words[8] = { 0, 5, 10, 15, 6, 7, 8, 9 };
+    uint32_t k[8];
+    for (int i = 0; i < 8; ++i) k[i] = u8to32(hout + 4*subkey_words[i]);
+
+    st[0] = salsa_constants[0];
+    st[5] = salsa_constants[1];
+    st[10] = salsa_constants[2];
+    st[15] = salsa_constants[3];
+    for (int i = 0; i < 4; ++i) {
+        st[1 + i] = k[i];
+        st[11 + i] = k[4 + i];
+    }
+    st[6] = u8to32(nonce + 16);
+    st[7] = u8to32(nonce + 20);
+    st[8] = (uint32_t)counter;
+    st[9] = (uint32_t)(counter >> 32);
+}
+
+// 32-byte subkey = HSalsa20(key, nonce[0..15])
+void hsalsa20(uint8_t subkey[32], const uint8_t key[32], const uint8_t nonce[16]) {
+    static const int subkey_words[8] = { 0, 5, 10, 15, 6, 7, 8, 9 };
+    uint32_t st[16];
+    uint8_t out[64];
+
+    hsalsa20_setup(st, key, nonce);
+    salsa20_permute_sse2(out, st, SALSA_ROUNDS);
+    for (int i = 0; i < 8; ++i) memcpy(subkey + 4*i, out + 4*subkey_words[i], 4);
+}
+
+// out = in ^ Salsa20 keystream from st; whole blocks widest kernel first,
+// the last partial block through a stack buffer.  Advances st's counter.
+static void salsa20_xor_stream(uint8_t *out, const uint8_t *in, size_t len, uint32_t st[16]) {
+    size_t pos = 0;
+    if (salsa20_have_avx2()) {
+        for (; len - pos >= 512; pos += 512) {
+            salsa20_xor_blocks8_avx2(out + pos, in + pos, st, SALSA_ROUNDS);
+            salsa20_counter_add(st, 8);
+        }
+    }
+    for (; len - pos >= 256; pos += 256) {
+        salsa20_xor_blocks4_sse2(out + pos, in + pos, st, SALSA_ROUNDS);
+        salsa20_counter_add(st, 4);
+    }
+    for (; len - pos >= 64; pos += 64) {
+        salsa20_xor_block_sse2(out + pos, in + pos, st, SALSA_ROUNDS);
+        salsa20_counter_add(st, 1);
+    }
+    if (pos < len) {
+        uint8_t ks[64] __attribute__((aligned(KEYSTREAM_ALIGN)));
+        salsa20_keystream(ks, st, 1, SALSA_ROUNDS);
+        keystream_xor(out + pos, in + pos, ks, len - pos);
+    }
+}
+
+// XSalsa20 stream cipher, counter starts at 0
+void xsalsa20_xor(uint8_t *out, const uint8_t *in, size_t len,
+                  const uint8_t nonce[24], const uint8_t key[32]) {
+    uint32_t st[16];
+    uint8_t hout[64];
+
+    hsalsa20_setup(st, key, nonce);
+    salsa20_permute_sse2(hout, st, SALSA_ROUNDS);
+    xsalsa20_setup(st, hout, nonce, 0);
+    salsa20_xor_stream(out, in, len, st);
+}
+
+// One block for each of n (<= 8) unrelated states, eight lanes at once when
+// AVX2 is available
+static void salsa20_lanes(uint8_t *const out[SECRETBOX_LANES], const uint32_t *const st[SECRETBOX_LANES],
+                          int n, int feed_forward) {
+    if (salsa20_have_avx2()) {
+        uint8_t scratch[64];
+        uint8_t *o[SECRETBOX_LANES];
+        const uint32_t *s[SECRETBOX_LANES];
+        for (int k = 0; k < SECRETBOX_LANES; ++k) {
+            o[k] = (k < n) ? out[k] : scratch;
+            s[k] = (k < n) ? st[k] : st[0];
+        }
+        salsa20_blocks8_lanes_avx2(o, s, SALSA_ROUNDS, feed_forward);
+        return;
+    }
+    for (int k = 0; k < n; ++k) {
+        if (feed_forward) salsa20_xor_block_sse2(out[k], NULL, st[k], SALSA_ROUNDS);
+        else salsa20_permute_sse2(out[k], st[k], SALSA_ROUNDS);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Batched secretbox
+// ---------------------------------------------------------------------------
+
+// Seal or open up to SECRETBOX_LANES boxes.  Keystream block 0 gives the
+// Poly1305 key (bytes 0..31) and encrypts message bytes 0..31 (bytes 32..63);
+// block j >= 1 encrypts message bytes 32 + 64*(j-1) onwards.
+static int secretbox_group(secretbox_item_t *items, int n, const uint8_t key[32], int open, int *results) {
+    uint32_t st[SECRETBOX_LANES][16];
+    uint8_t blk0[SECRETBOX_LANES][64];
+    uint8_t tail[SECRETBOX_LANES][64];
+    const uint32_t *stp[SECRETBOX_LANES] = {0};
+    uint8_t *outp[SECRETBOX_LANES] = {0};
+    int ok[SECRETBOX_LANES];
+    int failed = 0;
+
+    // HSalsa20 subkeys, then keystream block 0 of each box
+    for (int k = 0; k < n; ++k) {
+        hsalsa20_setup(st[k], key, items[k].nonce);
+        stp[k] = st[k];
+        outp[k] = blk0[k];
+    }
+    salsa20_lanes(outp, stp, n, 0);
+    for (int k = 0; k < n; ++k) xsalsa20_setup(st[k], blk0[k], items[k].nonce, 0);
+    salsa20_lanes(outp, stp, n, 1);
+
+    // Open: authenticate the ciphertext before decrypting anything
+    for (int k = 0; k < n; ++k) {
+        ok[k] = 1;
+        if (open) {
+            uint8_t tag[SECRETBOX_MACBYTES];
+            poly1305(tag, items[k].in + SECRETBOX_MACBYTES, items[k].mlen, blk0[k]);
+            ok[k] = poly1305_verify(tag, items[k].in);
+            if (!ok[k]) {
+                memset(items[k].out, 0, items[k].mlen);
+                failed++;
+            }
+        }
+        if (results) results[k] = ok[k] ? 0 : -1;
+    }
+
+    // Message bytes 0..31 from block 0, whole middle blocks from the
+    // same-key kernels, and collect the last partial blocks
+    int ntail = 0;
+    int tail_item[SECRETBOX_LANES];
+    for (int k = 0; k < n; ++k) {
+        if (!ok[k]) continue;
+        const uint8_t *src = open ? items[k].in + SECRETBOX_MACBYTES : items[k].in;
+        uint8_t *dst = open ? items[k].out : items[k].out + SECRETBOX_MACBYTES;
+        size_t mlen = items[k].mlen;
+        size_t first = mlen < 32 ? mlen : 32;
+
+        keystream_xor(dst, src, blk0[k] + 32, first);
+        if (mlen > 32) {
+            size_t rest = mlen - 32;
+            size_t whole = rest & ~(size_t)63;
+            salsa20_counter_add(st[k], 1);
+            salsa20_xor_stream(dst + 32, src + 32, whole, st[k]);
+            if (rest > whole) {
+                stp[ntail] = st[k];
+                outp[ntail] = tail[ntail];
+                tail_item[ntail++] = k;
+            }
+        }
+    }
+    if (ntail > 0) {
+        salsa20_lanes(outp, stp, ntail, 1);
+        for (int t = 0; t < ntail; ++t) {
+            int k = tail_item[t];
+            const uint8_t *src = open ? items[k].in + SECRETBOX_MACBYTES : items[k].in;
+            uint8_t *dst = open ? items[k].out : items[k].out + SECRETBOX_MACBYTES;
+            size_t start = 32 + ((items[k].mlen - 32) & ~(size_t)63);
+            keystream_xor(dst + start, src + start, tail[t], items[k].mlen - start);
+        }
+    }
+
+    // Seal: tag over the ciphertext
+    if (!open) {
+        for (int k = 0; k < n; ++k)
+            poly1305(items[k].out, items[k].out + SECRETBOX_MACBYTES, items[k].mlen, blk0[k]);
+    }
+
+    memset(blk0, 0, sizeof(blk0));
+    memset(st, 0, sizeof(st));
+    return failed;
+}
+
+// Seal n boxes under one key; items[i].out receives mlen + 16 bytes
+void secretbox_seal_batch(secretbox_item_t *items, size_t n, const uint8_t key[32]) {
+    for (size_t i = 0; i < n; i += SECRETBOX_LANES) {
+        int g = (n - i < SECRETBOX_LANES) ? (int)(n - i) : SECRETBOX_LANES;
+        secretbox_group(items + i, g, key, 0, NULL);
+    }
+}
+
+// Open n boxes; results[i] = 0 if the tag verified, -1 otherwise (that
+// box's plaintext is zeroed).  Returns the number of boxes that failed.
+size_t secretbox_open_batch(secretbox_item_t *items, size_t n, const uint8_t key[32], int *results) {
+    size_t failed = 0;
+    for (size_t i = 0; i < n; i += SECRETBOX_LANES) {
+        int g = (n - i < SECRETBOX_LANES) ? (int)(n - i) : SECRETBOX_LANES;
+        failed += (size_t)secretbox_group(items + i, g, key, 1, results ? results + i : NULL);
+    }
+    return failed;
+}
+
+// Single-box wrappers (crypto_secretbox_easy / crypto_secretbox_open_easy)
+void secretbox_seal(uint8_t *box, const uint8_t *m, size_t mlen,
+                    const uint8_t nonce[24], const uint8_t key[32]) {
+    secretbox_item_t it = { nonce, m, box, mlen };
+    secretbox_seal_batch(&it, 1, key);
+}
+
+int secretbox_open(uint8_t *m, const uint8_t *box, size_t mlen,
+                   const uint8_t nonce[24], const uint8_t key[32]) {
+    secretbox_item_t it = { nonce, box, m, mlen };
+    int res;
+    secretbox_open_batch(&it, 1, key, &res);
+    return res;
+}
+
+// ---------------------------------------------------------------------------
+// Self-check and benchmark
+// ---------------------------------------------------------------------------
+
+// Simple LCG PRNG for benchmarking
+static uint32_t lcg_seed = 987654321;
+uint32_t lcg_rand() {
+    lcg_seed = (1103515245u * lcg_seed + 12345u) & 0x7fffffffu;
+    return lcg_seed;
+}
+void generate_random(uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; ++i) buf[i] = (uint8_t)(lcg_rand() & 0xffu);
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int secretbox_self_check(void) {
+    // RFC 8439 section 2.5.2 Poly1305 vector
+    static const uint8_t pkey[32] = {
+        0x85,0xd6,0xbe,0x78,0x57,0x55,0x6d,0x33,0x7f,0x44,0x52,0xfe,0x42,0xd5,0x06,0xa8,
+        0x01,0x03,0x80,0x8a,0xfb,0x0d,0xb2,0xfd,0x4a,0xbf,0xf6,0xaf,0x41,0x49,0xf5,0x1b
+    };
+    static const uint8_t ptag[16] = {
+        0xa8,0x06,0x1d,0xc1,0x30,0x51,0x36,0xc6,0xc2,0x2b,0x8b,0xaf,0x0c,0x01,0x27,0xa9
+    };
+    // crypto_secretbox_easy(m = "Salsa20 secretbox KAT", nonce = 0..23, key = 0..31)
+    static const uint8_t kat_box[16 + 21] = {
+        0xc4,0x23,0x12,0x6d,0xe1,0x3a,0x89,0x42,0x42,0x0d,0xfc,0x87,0x17,0xf6,0xd6,0xf4,
+        0x0d,0x9e,0x54,0x3c,0xa6,0xf8,0x92,0x30,0xc8,0x59,0xec,0x4c,0x0d,0xfb,0x28,0xf8,
+        0x2a,0x85,0x0d,0x9e,0xd8
+    };
+    const char *msg = "Cryptographic Forum Research Group";
+    const char *kat_msg = "Salsa20 secretbox KAT";
+    uint8_t tag[16], key[32], nonce[24], box[16 + 21], back[21];
+
+    poly1305(tag, (const uint8_t *)msg, strlen(msg), pkey);
+    if (memcmp(tag, ptag, 16) != 0) {
+        printf("Self-check FAILED: Poly1305 RFC 8439 vector\n");
+        return 0;
+    }
+
+    for (int i = 0; i < 32; ++i) key[i] = (uint8_t)i;
+    for (int i = 0; i < 24; ++i) nonce[i] = (uint8_t)i;
+    secretbox_seal(box, (const uint8_t *)kat_msg, 21, nonce, key);
+    if (memcmp(box, kat_box, sizeof(kat_box)) != 0) {
+        printf("Self-check FAILED: secretbox known answer\n");
+        return 0;
+    }
+    if (secretbox_open(back, box, 21, nonce, key) != 0 || memcmp(back, kat_msg, 21) != 0) {
+        printf("Self-check FAILED: secretbox open\n");
+        return 0;
+    }
+    box[20] ^= 1;
+    if (secretbox_open(back, box, 21, nonce, key) == 0) {
+        printf("Self-check FAILED: forged box accepted\n");
+        return 0;
+    }
+
+    // Batched result must equal the one-box-at-a-time result for mixed sizes
+    enum { NB = 19 };
+    secretbox_item_t items[NB];
+    uint8_t *m = malloc(NB * 1100), *b1 = malloc(NB * 1116), *b2 = malloc(NB * 1116);
+    uint8_t nonces[NB][24];
+    int ok = (m && b1 && b2);
+    for (int i = 0; ok && i < NB; ++i) {
+        size_t len = (size_t)(i * 57) % 1100;
+        generate_random(nonces[i], 24);
+        generate_random(m + i * 1100, len);
+        items[i] = (secretbox_item_t){ nonces[i], m + i * 1100, b1 + i * 1116, len };
+        secretbox_seal(b2 + i * 1116, m + i * 1100, len, nonces[i], key);
+    }
+    if (ok) {
+        secretbox_seal_batch(items, NB, key);
+        for (int i = 0; i < NB; ++i)
+            if (memcmp(b1 + i * 1116, b2 + i * 1116, items[i].mlen + 16) != 0) ok = 0;
+        for (int i = 0; i < NB; ++i) {
+            items[i].in = b1 + i * 1116;
+            items[i].out = b2 + i * 1116;
+        }
+        if (secretbox_open_batch(items, NB, key, NULL) != 0) ok = 0;
+        for (int i = 0; i < NB; ++i)
+            if (memcmp(b2 + i * 1116, m + i * 1100, items[i].mlen) != 0) ok = 0;
+    }
+    if (!ok) printf("Self-check FAILED: batched seal/open\n");
+    free(m); free(b1); free(b2);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    bench_isolate(0);
+    bench_timing_init();
+
+    static const size_t sizes[] = { 64, 256, 1024, 4096, 16384 };
+    const size_t batch = 256;        // boxes per seal/open call
+    uint8_t key[SECRETBOX_KEYBYTES];
+
+    // optional arg: [total bytes per measurement, default 64 MB]
+    size_t budget = 64u << 20;
+    if (argc >= 2) budget = (size_t)atol(argv[1]);
+
+    if (!secretbox_self_check()) return 1;
+    printf("Self-check (Poly1305 RFC 8439, secretbox KAT, batch == single): OK\n");
+    printf("Lanes kernel: %s\n\n", salsa20_have_avx2() ? "AVX2 x8" : "SSE2 x1");
+
+    uint8_t *msgs = malloc(batch * 16384);
+    uint8_t *boxes = malloc(batch * (16384 + SECRETBOX_MACBYTES));
+    uint8_t *plain = malloc(batch * 16384);
+    uint8_t (*nonces)[SECRETBOX_NONCEBYTES] = malloc(batch * SECRETBOX_NONCEBYTES);
+    secretbox_item_t *items = malloc(batch * sizeof(*items));
+    if (!msgs || !boxes || !plain || !nonces || !items) {
+        perror("Failed to allocate memory");
+        return 1;
+    }
+    generate_random(key, sizeof(key));
+    generate_random(msgs, batch * 16384);
+    generate_random(&nonces[0][0], batch * SECRETBOX_NONCEBYTES);
+
+    printf("%8s %14s %14s %14s %12s %12s\n",
+           "payload", "seal boxes/s", "single boxes/s", "open boxes/s", "seal cyc/B", "open cyc/B");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        size_t len = sizes[s];
+        size_t calls = budget / (len * batch);
+        if (calls < 1) calls = 1;
+
+        for (size_t i = 0; i < batch; ++i)
+            items[i] = (secretbox_item_t){ nonces[i], msgs + i * len, boxes + i * (len + 16), len };
+
+        // Batched seal
+        double t0 = now_sec();
+        uint64_t c0 = bench_tsc_start();
+        for (size_t c = 0; c < calls; ++c) secretbox_seal_batch(items, batch, key);
+        uint64_t c1 = bench_tsc_stop();
+        double t1 = now_sec();
+
+        // One box per call, for comparison
+        double t2 = now_sec();
+        for (size_t c = 0; c < calls; ++c)
+            for (size_t i = 0; i < batch; ++i)
+                secretbox_seal(boxes + i * (len + 16), msgs + i * len, len, nonces[i], key);
+        double t3 = now_sec();
+
+        // Batched open
+        for (size_t i = 0; i < batch; ++i)
+            items[i] = (secretbox_item_t){ nonces[i], boxes + i * (len + 16), plain + i * len, len };
+        size_t failed = 0;
+        double t4 = now_sec();
+        uint64_t c2 = bench_tsc_start();
+        for (size_t c = 0; c < calls; ++c) failed += secretbox_open_batch(items, batch, key, NULL);
+        uint64_t c3 = bench_tsc_stop();
+        double t5 = now_sec();
+
+        double nbox = (double)(calls * batch);
+        printf("%8zu %14.0f %14.0f %14.0f %12.2f %12.2f%s\n", len,
+               nbox / (t1 - t0), nbox / (t3 - t2), nbox / (t5 - t4),
+               (double)bench_elapsed(c0, c1) / (nbox * len), (double)bench_elapsed(c2, c3) / (nbox * len),
+               failed ? "  (open FAILED)" : "");
+    }
+
+    free(msgs); free(boxes); free(plain); free(nonces); free(items);
+    return 0;
+}
@@ -0,0 +1,183 @@
+// sha256.h
+// SHA-256 (FIPS 180-4), HMAC-SHA256 (RFC 2104) and PBKDF2-HMAC-SHA256
+// (RFC 8018), header-only.
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define SHA256_DIGEST_LEN 32
+#define SHA256_BLOCK_LEN  64
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t total;      // bytes absorbed so far
+    uint8_t buf[64];
+    size_t buflen;
+} sha256_ctx_t;
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static inline uint32_t sha256_load_be(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void sha256_store_be(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline void sha256_compress(uint32_t h[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+
+    for (int i = 0; i < 16; ++i) w[i] = sha256_load_be(block + 4*i);
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    for (int i = 0; i < 64; ++i) {
+        uint32_t S1 = SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = k + S1 + ch + sha256_k[i] + w[i];
+        uint32_t S0 = SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = S0 + maj;
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+static inline void sha256_init(sha256_ctx_t *ctx) {
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->h, iv, sizeof(iv));
+    ctx->total = 0;
+    ctx->buflen = 0;
+}
+
+static inline void sha256_update(sha256_ctx_t *ctx, const uint8_t *data, size_t len) {
+    ctx->total += len;
+    if (ctx->buflen > 0) {
+        size_t take = 64 - ctx->buflen;
+        if (take > len) take = len;
+        memcpy(ctx->buf + ctx->buflen, data, take);
+        ctx->buflen += take;
+        data += take;
+        len -= take;
+        if (ctx->buflen < 64) return;
+        sha256_compress(ctx->h, ctx->buf);
+        ctx->buflen = 0;
+    }
+    for (; len >= 64; data += 64, len -= 64)
+        sha256_compress(ctx->h, data);
+    memcpy(ctx->buf, data, len);
+    ctx->buflen = len;
+}
+
+static inline void sha256_final(sha256_ctx_t *ctx, uint8_t out[SHA256_DIGEST_LEN]) {
+    uint64_t bits = ctx->total * 8;
+    uint8_t pad[72] = { 0x80 };
+    size_t padlen = (ctx->buflen < 56) ? 56 - ctx->buflen : 120 - ctx->buflen;
+
+    for (int i = 0; i < 8; ++i) pad[padlen + i] = (uint8_t)(bits >> (56 - 8*i));
+    sha256_update(ctx, pad, padlen + 8);
+    for (int i = 0; i < 8; ++i) sha256_store_be(out + 4*i, ctx->h[i]);
+}
+
+static inline void sha256(uint8_t out[SHA256_DIGEST_LEN], const uint8_t *data, size_t len) {
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, out);
+}
+
+// HMAC-SHA256 with the inner and outer pads absorbed once, so PBKDF2 can
+// reuse them for every block
+typedef struct {
+    sha256_ctx_t inner, outer;
+} hmac_sha256_ctx_t;
+
+static inline void hmac_sha256_init(hmac_sha256_ctx_t *ctx, const uint8_t *key, size_t keylen) {
+    uint8_t k[SHA256_BLOCK_LEN] = {0}, pad[SHA256_BLOCK_LEN];
+
+    if (keylen > SHA256_BLOCK_LEN) sha256(k, key, keylen);
+    else memcpy(k, key, keylen);
+
+    for (int i = 0; i < SHA256_BLOCK_LEN; ++i) pad[i] = k[i] ^ 0x36;
+    sha256_init(&ctx->inner);
+    sha256_update(&ctx->inner, pad, SHA256_BLOCK_LEN);
+    for (int i = 0; i < SHA256_BLOCK_LEN; ++i) pad[i] = k[i] ^ 0x5c;
+    sha256_init(&ctx->outer);
+    sha256_update(&ctx->outer, pad, SHA256_BLOCK_LEN);
+}
+
+static inline void hmac_sha256_update(hmac_sha256_ctx_t *ctx, const uint8_t *data, size_t len) {
+    sha256_update(&ctx->inner, data, len);
+}
+
+static inline void hmac_sha256_final(hmac_sha256_ctx_t *ctx, uint8_t out[SHA256_DIGEST_LEN]) {
+    uint8_t ih[SHA256_DIGEST_LEN];
+    sha256_final(&ctx->inner, ih);
+    sha256_update(&ctx->outer, ih, SHA256_DIGEST_LEN);
+    sha256_final(&ctx->outer, out);
+}
+
+static inline void hmac_sha256(uint8_t out[SHA256_DIGEST_LEN], const uint8_t *key, size_t keylen,
+                               const uint8_t *data, size_t len) {
+    hmac_sha256_ctx_t ctx;
+    hmac_sha256_init(&ctx, key, keylen);
+    hmac_sha256_update(&ctx, data, len);
+    hmac_sha256_final(&ctx, out);
+}
+
+static inline void pbkdf2_hmac_sha256(const uint8_t *pass, size_t passlen, const uint8_t *salt, size_t saltlen,
+                                      uint64_t iterations, uint8_t *out, size_t outlen) {
+    hmac_sha256_ctx_t base, ctx;
+    hmac_sha256_init(&base, pass, passlen);
+
+    for (uint32_t blk = 1; outlen > 0; ++blk) {
+        uint8_t idx[4], u[SHA256_DIGEST_LEN], t[SHA256_DIGEST_LEN];
+        sha256_store_be(idx, blk);
+
+        ctx = base;
+        hmac_sha256_update(&ctx, salt, saltlen);
+        hmac_sha256_update(&ctx, idx, 4);
+        hmac_sha256_final(&ctx, u);
+        memcpy(t, u, sizeof(t));
+        for (uint64_t it = 1; it < iterations; ++it) {
+            ctx = base;
+            hmac_sha256_update(&ctx, u, sizeof(u));
+            hmac_sha256_final(&ctx, u);
+            for (int i = 0; i < SHA256_DIGEST_LEN; ++i) t[i] ^= u[i];
+        }
+
+        size_t take = outlen < SHA256_DIGEST_LEN ? outlen : SHA256_DIGEST_LEN;
+        memcpy(out, t, take);
+        out += take;
+        outlen -= take;
+    }
+}
+
+#endif // SHA256_H